@@ -5,19 +5,28 @@
 #include <stdbool.h>
 
 #include "hal/include/serial.h"
+#include "hal/include/spinlock.h"
+#include "mem/include/mem.h"
 
 void kprint_init(void) {
     vga_clear();
     serial_com1_init();
 }
 
+void kprint_remap(void) { vga_textbuf_set(mem_phys_to_virt(VGA_TEXTBUF_PHYS)); }
+
+/// Keeps messages of different CPUs from interleaving.
+static struct spinlock_t KPRINT_LOCK = SPINLOCK_INIT("kprint");
+
 void kprintf(const char* format, ...) {
     va_list vlist_serial;
     va_start(vlist_serial, format);
     va_list vlist_vga;
     va_copy(vlist_vga, vlist_serial);
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&KPRINT_LOCK);
     serial_com1_vprintf(format, vlist_serial);
     vga_vprintf(format, vlist_vga);
+    spinlock_release_irqrestore(&KPRINT_LOCK, interrupts_were_enabled);
     va_end(vlist_vga);
     va_end(vlist_serial);
 }
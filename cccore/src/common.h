@@ -3,6 +3,11 @@
 /// Initialize the kernel console.
 void kprint_init(void);
 
+/// Access the console through the direct map from now on, as the identity map is going away.
+///
+/// Only call this once, after `mem_direct_map_init`.
+void kprint_remap(void);
+
 /// Print message to console.
 void kprintf(const char* format, ...);
 
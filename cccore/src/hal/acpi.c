@@ -0,0 +1,109 @@
+#include "include/acpi.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common.h"
+#include "mem.h"
+
+/// Root system description pointer, which the root table is found through.
+struct __attribute__((__packed__)) rsdp_t {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    // From here on only present since revision 2
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+};
+
+/// Size of the RSDP of revision 0, which the first checksum covers.
+static const size_t RSDP_V1_SIZE = 20;
+
+/// Root table, either the RSDT with 32-bit entries or the XSDT with 64-bit ones.
+static const struct acpi_sdt_header_t *ROOT = NULL;
+static size_t ROOT_ENTRY_SIZE = 0;
+
+/// Check whether all bytes sum up to zero, as they do in every intact ACPI structure.
+static bool checksum_valid(const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+static bool signature_equal(const char *a, const char *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Map a table's physical address, checking it's signature and checksum.
+///
+/// Return NULL if either doesn't match.
+static const struct acpi_sdt_header_t *table_map(uint64_t phys, const char *signature) {
+    const struct acpi_sdt_header_t *table = mem_phys_to_virt(phys);
+    if (!signature_equal(table->signature, signature, sizeof(table->signature))) {
+        return NULL;
+    }
+    if (!checksum_valid(table, table->length)) {
+        return NULL;
+    }
+    return table;
+}
+
+void acpi_init(const struct stivale2_struct_tag_rsdp *rsdp) {
+    if (rsdp == NULL) {
+        kprintf("%s: Bootloader did not pass an RSDP\n", __func__);
+        return;
+    }
+    // Like all pointers the bootloader passes, it points into it's direct map, which is ours
+    const struct rsdp_t *root_ptr = (const struct rsdp_t *)rsdp->rsdp;
+    if (!signature_equal(root_ptr->signature, "RSD PTR ", sizeof(root_ptr->signature)) ||
+        !checksum_valid(root_ptr, RSDP_V1_SIZE)) {
+        kprintf("%s: RSDP is invalid\n", __func__);
+        return;
+    }
+
+    // The XSDT supersedes the RSDT wherever there is one
+    if (root_ptr->revision >= 2 && root_ptr->xsdt_address != 0 && checksum_valid(root_ptr, root_ptr->length)) {
+        ROOT = table_map(root_ptr->xsdt_address, "XSDT");
+        ROOT_ENTRY_SIZE = sizeof(uint64_t);
+    }
+    if (ROOT == NULL) {
+        ROOT = table_map(root_ptr->rsdt_address, "RSDT");
+        ROOT_ENTRY_SIZE = sizeof(uint32_t);
+    }
+    if (ROOT == NULL) {
+        kprintf("%s: Root table is invalid\n", __func__);
+    }
+}
+
+const struct acpi_sdt_header_t *acpi_table_find(const char *signature) {
+    if (ROOT == NULL) {
+        return NULL;
+    }
+    const uint8_t *entries = (const uint8_t *)ROOT + sizeof(*ROOT);
+    const size_t entries_num = (ROOT->length - sizeof(*ROOT)) / ROOT_ENTRY_SIZE;
+    for (size_t i = 0; i < entries_num; i++) {
+        // Entries aren't necessarily aligned, and only the XSDT's are 64 bits wide
+        uint64_t phys = 0;
+        for (size_t byte = 0; byte < ROOT_ENTRY_SIZE; byte++) {
+            phys |= (uint64_t)entries[i * ROOT_ENTRY_SIZE + byte] << (byte * 8);
+        }
+        const struct acpi_sdt_header_t *table = table_map(phys, signature);
+        if (table != NULL) {
+            return table;
+        }
+    }
+    return NULL;
+}
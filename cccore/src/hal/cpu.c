@@ -0,0 +1,128 @@
+#include "include/cpu.h"
+
+#include <stdint.h>
+
+struct cpu_cpuid_t cpu_cpuid(uint32_t leaf, uint32_t subleaf) {
+    struct cpu_cpuid_t out;
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "cpuid                  \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=a"(out.eax), "=b"(out.ebx), "=c"(out.ecx), "=d"(out.edx)
+        : "a"(leaf), "c"(subleaf));
+    return out;
+}
+
+uint64_t cpu_rdmsr(uint32_t msr) {
+    uint32_t lo;
+    uint32_t hi;
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "rdmsr                  \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=a"(lo), "=d"(hi)
+        : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+void cpu_wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "wrmsr                  \n\t"
+        ".att_syntax prefix     \n\t"
+        :
+        : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+uint64_t cpu_rdtsc(void) {
+    uint32_t lo;
+    uint32_t hi;
+    // lfence keeps the read from being executed ahead of earlier instructions
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "lfence                 \n\t"
+        "rdtsc                  \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+uint64_t cpu_read_cr0(void) {
+    uint64_t cr0;
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "mov %0, cr0            \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=r"(cr0));
+    return cr0;
+}
+
+void cpu_write_cr0(uint64_t cr0) {
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "mov cr0, %0            \n\t"
+        ".att_syntax prefix     \n\t"
+        :
+        : "r"(cr0)
+        : "memory");
+}
+
+uint64_t cpu_read_cr3(void) {
+    uint64_t cr3;
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "mov %0, cr3            \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=r"(cr3));
+    return cr3;
+}
+
+void cpu_write_cr3(uint64_t cr3) {
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "mov cr3, %0            \n\t"
+        ".att_syntax prefix     \n\t"
+        :
+        : "r"(cr3)
+        : "memory");
+}
+
+uint64_t cpu_read_cr4(void) {
+    uint64_t cr4;
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "mov %0, cr4            \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=r"(cr4));
+    return cr4;
+}
+
+void cpu_write_cr4(uint64_t cr4) {
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "mov cr4, %0            \n\t"
+        ".att_syntax prefix     \n\t"
+        :
+        : "r"(cr4)
+        : "memory");
+}
+
+uint64_t cpu_read_cr2(void) {
+    uint64_t cr2;
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "mov %0, cr2            \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=r"(cr2));
+    return cr2;
+}
+
+void cpu_invlpg(uintptr_t virt) {
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "invlpg [%0]            \n\t"
+        ".att_syntax prefix     \n\t"
+        :
+        : "r"(virt)
+        : "memory");
+}
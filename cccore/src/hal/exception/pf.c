@@ -1,21 +1,38 @@
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "../../common.h"
+#include "../include/cpu.h"
+#include "../include/exception.h"
 #include "../include/interrupt.h"
 
 static const uint8_t INTERRUPT_NUM = 14;
 
+/// Number of hooks that can be registered.
+#define PF_HOOKS_NUM 4
+
+static exception_pf_hook_t PF_HOOKS[PF_HOOKS_NUM] = {NULL};
+
+void exception_pf_hook_register(exception_pf_hook_t hook) {
+    for (size_t i = 0; i < PF_HOOKS_NUM; i++) {
+        if (PF_HOOKS[i] == NULL) {
+            PF_HOOKS[i] = hook;
+            return;
+        }
+    }
+    kpanicf("%s: No room for another page fault hook\n", __func__);
+}
+
 static void pf(struct interrupt_isr_data_t *data) {
     // Determine which virtual address caused fault
-    uint64_t cr2;
-    __asm__ volatile(
-        ".intel_syntax noprefix \n\t"
-        "mov rax, cr2           \n\t"
-        "mov %0, rax            \n\t"
-        ".att_syntax prefix     \n\t"
-        : "=r"(cr2)
-        :
-        : "rax");
+    const uint64_t cr2 = cpu_read_cr2();
+
+    for (size_t i = 0; i < PF_HOOKS_NUM && PF_HOOKS[i] != NULL; i++) {
+        if (PF_HOOKS[i](cr2, data->int_arg, data)) {
+            return;
+        }
+    }
 
     // Parse the error code
     const uint64_t err = data->int_arg;
@@ -3,6 +3,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "include/smp.h"
+
 static const uint64_t ONE = 1;  // Because of stupid integer promotion rules
 static const uint64_t GDT_FLAG_RW = ONE << 41;
 static const uint64_t GDT_FLAG_CODE = ONE << 43;
@@ -10,14 +12,35 @@ static const uint64_t GDT_FLAG_CODE_OR_DATA = ONE << 44;
 static const uint64_t GDT_FLAG_PRESENT = ONE << 47;
 static const uint64_t GDT_FLAG_LONG = ONE << 53;
 
+/// Type of an available 64-bit TSS in a system descriptor.
+static const uint64_t GDT_TYPE_TSS_AVAILABLE = ONE << 40 | ONE << 43;
+
+/// Task state segment, which in long mode only holds the stacks the CPU switches to on interrupts.
+struct __attribute__((__packed__)) tss_t {
+    uint32_t reserved_1;
+    /// Stacks for interrupts raising the privilege level to the given ring.
+    uint64_t rsp[3];
+    uint64_t reserved_2;
+    /// Stacks for interrupts whose IDT entry selects IST `i + 1`.
+    uint64_t ist[GDT_IST_NUM];
+    uint64_t reserved_3;
+    uint16_t reserved_4;
+    /// Offset of the I/O permission bitmap, pointing past the segment's end as there is none.
+    uint16_t iomap_base;
+};
+
+static struct tss_t TSS[SMP_CPUS_MAX];
+
 /// Descriptor telling the CPU where to find the GDT.
 struct __attribute__((__packed__)) gdt_info_t {
     uint16_t size;
     uint64_t offset;
 };
 
-// We only set up identity mappings and never touch them again, so this amount suffices
-#define GDT_NUM_ENTRIES 2
+// We only set up identity mappings and never touch them again, so this amount suffices.
+// Each CPU's TSS descriptor follows, taking up two entries.
+#define GDT_TSS_FIRST_ENTRY 2
+#define GDT_NUM_ENTRIES (GDT_TSS_FIRST_ENTRY + 2 * SMP_CPUS_MAX)
 static __attribute__((aligned(16))) uint64_t GDT[GDT_NUM_ENTRIES];
 static __attribute__((aligned(16))) __attribute__((used)) struct gdt_info_t GDT_INFO = {
     .size = (GDT_NUM_ENTRIES * sizeof(uint64_t)) - 1,
@@ -55,3 +78,33 @@ void gdt_init_flat(void) {
         :
         : "rax");
 }
+
+void gdt_tss_init(size_t cpu, const uintptr_t ist_tops[GDT_IST_NUM]) {
+    struct tss_t *tss = &TSS[cpu];
+    for (size_t i = 0; i < GDT_IST_NUM; i++) {
+        tss->ist[i] = ist_tops[i];
+    }
+    tss->iomap_base = sizeof(*tss);
+
+    // Like code descriptors, with the base and limit used, and the upper half of the base in the next entry
+    const uint64_t base = (uint64_t)tss;
+    const uint64_t limit = sizeof(*tss) - 1;
+    const size_t entry = GDT_TSS_FIRST_ENTRY + 2 * cpu;
+    GDT[entry] = (limit & 0xFFFF) | ((base & 0xFFFFFF) << 16) | GDT_TYPE_TSS_AVAILABLE | GDT_FLAG_PRESENT |
+                 (((limit >> 16) & 0xF) << 48) | (((base >> 24) & 0xFF) << 56);
+    GDT[entry + 1] = base >> 32;
+}
+
+void gdt_tss_load(void) {
+    const uint16_t selector = (uint16_t)((GDT_TSS_FIRST_ENTRY + 2 * smp_cpu()->id) * sizeof(uint64_t));
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "ltr %0                 \n\t"
+        ".att_syntax prefix     \n\t"
+        :
+        : "r"(selector));
+}
+
+uintptr_t gdt_ist_get(uint8_t ist) { return TSS[smp_cpu()->id].ist[ist - 1]; }
+
+void gdt_ist_set(uint8_t ist, uintptr_t top) { TSS[smp_cpu()->id].ist[ist - 1] = top; }
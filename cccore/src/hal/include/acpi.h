@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "stivale2.h"
+
+//! Finding the ACPI tables the firmware describes the machine with.
+//!
+//! Only the static tables are looked at, there's no AML interpreter.
+
+/// Header every ACPI system description table starts with.
+struct __attribute__((__packed__)) acpi_sdt_header_t {
+    char signature[4];
+    /// Size of the whole table, including this header.
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+};
+
+/// Locate the root table through the RSDP the bootloader found.
+///
+/// Without the bootloader's RSDP, no table is ever found.
+///
+/// Only call this once, on the BSP, once the direct map is set up.
+void acpi_init(const struct stivale2_struct_tag_rsdp *rsdp);
+
+/// Find the first table with the given four character signature, such as `"APIC"` for the MADT.
+///
+/// Tables with a wrong checksum are skipped.
+///
+/// Return NULL if there's no such table.
+const struct acpi_sdt_header_t *acpi_table_find(const char *signature);
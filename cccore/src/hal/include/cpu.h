@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+//! Access to CPU facilities that don't belong to any particular device.
+
+/// Registers returned by the CPUID instruction.
+struct cpu_cpuid_t {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+};
+
+/// Execute CPUID for the given leaf and subleaf.
+struct cpu_cpuid_t cpu_cpuid(uint32_t leaf, uint32_t subleaf);
+
+/// Read a model-specific register.
+uint64_t cpu_rdmsr(uint32_t msr);
+
+/// Write a model-specific register.
+void cpu_wrmsr(uint32_t msr, uint64_t value);
+
+/// Read the time stamp counter.
+uint64_t cpu_rdtsc(void);
+
+/// Read control register 0, which controls basic operating modes.
+uint64_t cpu_read_cr0(void);
+
+/// Write control register 0.
+void cpu_write_cr0(uint64_t cr0);
+
+/// Read the physical address of the active top-level page table, along with it's flags.
+uint64_t cpu_read_cr3(void);
+
+/// Switch to another top-level page table, which also flushes all non-global TLB entries.
+void cpu_write_cr3(uint64_t cr3);
+
+/// Read control register 4, which enables various CPU extensions.
+uint64_t cpu_read_cr4(void);
+
+/// Write control register 4.
+void cpu_write_cr4(uint64_t cr4);
+
+/// Read the virtual address that caused the last page fault.
+uint64_t cpu_read_cr2(void);
+
+/// Drop the TLB entry for the page containing the given virtual address.
+void cpu_invlpg(uintptr_t virt);
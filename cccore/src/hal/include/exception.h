@@ -1,7 +1,25 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "interrupt.h"
+
 /// Register default exception handlers which
 /// provide debug information before halting the machine.
 ///
 /// Interrupts must be initialized before calling this.
 void exception_register_default(void);
+
+/// Function given a chance to deal with a page fault before the default handler halts the machine.
+///
+/// Return `true` if the fault was resolved and the faulting instruction may be retried.
+///
+/// Return `false` if the fault is none of it's business, so the next hook is asked.
+/// Hooks that recognize a fault as fatal may also panic with a more specific message themselves.
+typedef bool (*exception_pf_hook_t)(uint64_t fault_addr, uint64_t err, struct interrupt_isr_data_t *data);
+
+/// Register a hook for page faults.
+///
+/// Hooks are asked in the order they were registered.
+void exception_pf_hook_register(exception_pf_hook_t hook);
@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 /// Index of 64-bit code descriptor.
@@ -6,3 +7,21 @@ extern const uint16_t GDT_CODE_IDX;
 
 /// Initialize a flat memory mapping.
 void gdt_init_flat(void);
+
+/// Number of interrupt stack table entries in a task state segment.
+#define GDT_IST_NUM 7
+
+/// Set up the given CPU's task state segment, and it's descriptor.
+///
+/// The CPU switches to `ist_tops[i]` for interrupts whose IDT entry selects IST `i + 1`, or stays on the current
+/// stack where it's `0`.
+void gdt_tss_init(size_t cpu, const uintptr_t ist_tops[GDT_IST_NUM]);
+
+/// Load the calling CPU's task state segment, once it was set up with `gdt_tss_init`.
+void gdt_tss_load(void);
+
+/// Get where the calling CPU switches to for interrupts selecting the given IST, counting from `1`.
+uintptr_t gdt_ist_get(uint8_t ist);
+
+/// Change where the calling CPU switches to for interrupts selecting the given IST, counting from `1`.
+void gdt_ist_set(uint8_t ist, uintptr_t top);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /// Data that is passed by the ASM stubs to all C ISRs.
@@ -43,6 +45,8 @@ void kprintf_interrupt_isr_data_t(const struct interrupt_isr_data_t* data);
 /// Signature that all custom ISRs must obey.
 ///
 /// Writing to the struct will modify the respective register on ISR exit.
+/// For IRQs, the callee-saved registers (rbx, rbp and r12 to r15) are neither saved nor restored though, as the
+/// handler preserves them anyways. They're only filled in once the handler switched threads.
 typedef void (*interrupt_isr_t)(struct interrupt_isr_data_t*);
 
 /// Initialize relevant data structures and hardware for processing interrupts.
@@ -51,12 +55,100 @@ typedef void (*interrupt_isr_t)(struct interrupt_isr_data_t*);
 /// These simply log the occurrence to debug output and halt the machine.
 void interrupt_init(void);
 
+/// Load the IDT set up by `interrupt_init` on an application processor, as well as it's task state segment set up by
+/// `interrupt_stacks_init`.
+void interrupt_init_ap(void);
+
+/// Allocate every CPU's interrupt stacks, and load the BSP's task state segment holding them.
+///
+/// From then on, handlers of IRQs, syscalls and most exceptions run on a stack of the CPU's own, while the interrupted
+/// thread's stack only holds the frame.
+/// NMIs, double faults, machine checks and page faults have the CPU switch stacks before pushing anything,
+/// so that they can be reported even if the thread's stack overflowed.
+///
+/// Only call this once, on the BSP, once physical memory is managed and before starting the application processors.
+void interrupt_stacks_init(void);
+
+struct stivale2_struct_tag_rsdp;
+
+/// Switch from the legacy PIC to the I/O APICs listed in the ACPI tables, if there are any.
+///
+/// Lines unmasked so far stay unmasked, and all of them keep their IDT slots.
+/// Without the bootloader's RSDP, an I/O APIC or a local APIC, the PIC stays in use.
+///
+/// Only call this once, on the BSP, after `ipi_init` and before starting the application processors.
+void interrupt_controller_init(const struct stivale2_struct_tag_rsdp* rsdp);
+
+/// Calculate which IDT slot the legacy ISA IRQ is raised at, whichever interrupt controller is in use.
+uint8_t interrupt_irq_to_idt_slot(uint8_t irq);
+
+/// Stop the interrupt controller from delivering the IRQ line raised at the IDT slot.
+///
+/// Does nothing for IDT slots no line is raised at, such as exceptions, IPIs and message-signalled interrupts.
+void interrupt_mask(uint8_t idt_slot);
+
+/// Have the interrupt controller deliver the IRQ line raised at the IDT slot.
+///
+/// All lines start out masked, so drivers call this once their handler is registered.
+/// Does nothing for IDT slots no line is raised at, such as exceptions, IPIs and message-signalled interrupts.
+void interrupt_unmask(uint8_t idt_slot);
+
+/// Deliver the IRQ line raised at the IDT slot to the given CPU, rather than the BSP.
+///
+/// Return `-1` if no line is raised at the IDT slot, or the interrupt controller only delivers to the BSP.
+///
+/// Return `0` on success.
+int interrupt_route(uint8_t idt_slot, size_t cpu);
+
+/// What a device writes to raise a message-signalled interrupt, to be programmed into it's MSI capability.
+struct interrupt_msi_t {
+    uint64_t address;
+    uint32_t data;
+};
+
+/// Take an IDT slot for a message-signalled interrupt, which is delivered to the given CPU.
+///
+/// The handler acknowledges it with `interrupt_ack` like any other, while masking is up to the device.
+///
+/// Return `-1` if there's no local APIC, the CPU doesn't exist or all IDT slots for MSIs are taken.
+///
+/// Return `0` on success, with the IDT slot and the message to program into the device written to the out parameters.
+int interrupt_msi_alloc(size_t cpu, uint8_t* idt_slot, struct interrupt_msi_t* msi);
+
+/// Give back an IDT slot taken by `interrupt_msi_alloc`, once the device no longer raises it.
+void interrupt_msi_free(uint8_t idt_slot);
+
 /// Register a non-default interrupt handler.
+///
+/// Other CPUs may still be running the previous handler until `rcu_synchronize` returns.
 void interrupt_register(interrupt_isr_t isr, uint8_t idt_slot);
 
+/// Dump the saved registers with kprintf whenever an interrupt at the IDT slot is taken, or stop doing so.
+///
+/// If the handler switches threads, the frame it resumes is dumped as well.
+/// Frames of IRQs only hold the callee-saved registers once they're resumed after a switch.
+/// Tracing is off for all IDT slots at first, as the dumps take far longer than handling the interrupt.
+void interrupt_trace_set(uint8_t idt_slot, bool enabled);
+
+/// Resume the given frame instead of the interrupted one once the current handler returns.
+///
+/// This is how threads are switched: The frame must have been saved by a previous interrupt (or be crafted to look
+/// like it), and lie on the stack of the thread it belongs to.
+/// Only call this from within an interrupt handler.
+void interrupt_resume_frame_set(struct interrupt_isr_data_t* frame);
+
+struct ticketlock_t;
+
+/// Release the lock right before the given frame is resumed, on the calling CPU.
+///
+/// This is how a lock protecting a thread switch is held until the CPU left the old thread's stack,
+/// whether the switch happens within an interrupt handler or not.
+/// Interrupts must be disabled until the frame is resumed.
+void interrupt_resume_unlock_set(struct ticketlock_t* lock, struct interrupt_isr_data_t* frame);
+
 /// Acknowledge the interrupt to whatever interrupt controller underlies it.
 ///
-/// Your non-default interrupt handlers must call this if appropriate.
+/// Your non-default interrupt handlers must call this if appropriate, for IRQ lines as well as MSIs.
 /// Do not call this for interrupts that are CPU-internal (AKA exceptions), which don't have a controller.
 void interrupt_ack(uint8_t idt_slot);
 
@@ -65,3 +157,6 @@ void interrupt_enable(void);
 
 /// Disable interrupts.
 void interrupt_disable(void);
+
+/// Check whether interrupts are currently enabled.
+bool interrupt_enabled(void);
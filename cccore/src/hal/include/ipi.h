@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "interrupt.h"
+#include "smp.h"
+
+//! Inter-processor interrupts, for getting other CPUs to do something right away.
+//!
+//! Besides sending plain interrupts, a function can be run on other CPUs, for example to invalidate their TLBs.
+//! The caller waits until all of them are done. Meanwhile it runs the functions other CPUs ask of it,
+//! so two CPUs calling each other at the same time don't deadlock.
+//! It must not hold any lock the other CPUs may be spinning on with interrupts disabled though.
+
+/// Set of CPUs, with bit `i` standing for `SMP_CPUS[i]`.
+typedef uint64_t ipi_cpu_mask_t;
+
+_Static_assert(SMP_CPUS_MAX <= 64, "ipi_cpu_mask_t can't hold all CPUs");
+
+/// Vector of the IPI asking a CPU to run functions in `ipi_call_mask`.
+#define IPI_VECTOR_CALL 0xF0
+
+/// Vector of the IPI asking a CPU to reschedule, as a thread became ready in it's run queues.
+#define IPI_VECTOR_RESCHEDULE 0xF1
+
+/// Function run on other CPUs, in interrupt context.
+typedef void (*ipi_func_t)(void *arg);
+
+/// A function call some CPU asked others to make.
+struct ipi_call_t {
+    ipi_func_t func;
+    void *arg;
+    /// Number of CPUs that haven't returned from the function yet.
+    volatile uint32_t remaining;
+};
+
+/// Enable the local APIC and register the handlers of IPIs.
+///
+/// Only call this once, on the BSP, once the direct map is set up.
+void ipi_init(void);
+
+/// Enable the local APIC on an application processor, so that it can send and receive IPIs.
+void ipi_init_ap(void);
+
+/// Have reschedule IPIs call the given function, once they're acknowledged.
+///
+/// Only call this once, before any CPU sends reschedule IPIs.
+void ipi_reschedule_enable(interrupt_isr_t callback);
+
+/// Send an IPI with the given vector to a single CPU.
+void ipi_send(size_t cpu, uint8_t vector);
+
+/// Send an IPI with the given vector to every CPU in the mask, skipping the calling one.
+void ipi_send_mask(ipi_cpu_mask_t cpus, uint8_t vector);
+
+/// Send an IPI with the given vector to every online CPU but the calling one.
+void ipi_send_all(uint8_t vector);
+
+/// Run the function on every online CPU in the mask but the calling one, and wait until all of them returned.
+///
+/// The function runs with interrupts disabled, and must neither block nor take locks the caller holds.
+void ipi_call_mask(ipi_cpu_mask_t cpus, ipi_func_t func, void *arg);
+
+/// Run the function on a single CPU, and wait until it returned.
+void ipi_call(size_t cpu, ipi_func_t func, void *arg);
+
+/// Run the function on every online CPU but the calling one, and wait until all of them returned.
+void ipi_call_all(ipi_func_t func, void *arg);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "interrupt.h"
+
+//! Read-copy-update, for data that is read all the time but hardly ever changes.
+//!
+//! Readers neither take locks nor write to memory other CPUs touch, so reading scales with the number of CPUs.
+//! Writers publish the new version with `rcu_assign_pointer` instead, and call `rcu_synchronize`
+//! before reclaiming the old one, which waits until no reader can possibly still hold on to it.
+//!
+//! Reading happens within read-side critical sections, which are the code between `rcu_read_lock` and
+//! `rcu_read_unlock` as well as all interrupt handlers. Both run with interrupts disabled,
+//! so the CPU won't switch threads in the middle of one.
+//! Whenever a CPU is known not to be within one, it passes through a quiescent state:
+//! - When it switches threads.
+//! - When it takes a timer interrupt, as those only arrive while interrupts are enabled.
+//!
+//! Once every CPU passed through a quiescent state after the writer published it's update, all readers
+//! that could have seen the old version are done.
+
+/// Load a pointer published with `rcu_assign_pointer`.
+///
+/// The pointee may only be used until the enclosing read-side critical section ends.
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+/// Publish a pointer, such that readers loading it with `rcu_dereference` see everything written to the pointee.
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/// Enter a read-side critical section, by disabling interrupts.
+///
+/// Return whether interrupts were enabled before, for `rcu_read_unlock`.
+static inline bool rcu_read_lock(void) {
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    return interrupts_were_enabled;
+}
+
+/// Leave a read-side critical section, enabling interrupts again if they were enabled before `rcu_read_lock`.
+static inline void rcu_read_unlock(bool interrupts_were_enabled) {
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
+
+/// Note that the calling CPU is in a quiescent state.
+///
+/// Only call this with interrupts disabled, outside of any read-side critical section.
+void rcu_quiescent(void);
+
+/// Block until every CPU passed through a quiescent state, after which the previous version of anything updated
+/// before may be reclaimed.
+///
+/// Only call this from threads, outside of any read-side critical section.
+void rcu_synchronize(void);
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct notification_t;
+
 //! Abstraction layer for the legacy serial port.
 
 /// The serial baud rate supported by the driver.
@@ -12,6 +15,16 @@ extern const uint32_t SERIAL_BAUD_RATE;
 /// Interrupts must be enabled for serial comms to work.
 void serial_com1_init(void);
 
+/// Signal the given bits on the notification whenever data arrives, for a thread to read it with `serial_com1_read`.
+///
+/// Until a notification is set, received data is echoed to debug output instead.
+void serial_com1_rx_notify(struct notification_t* n, uint64_t bits);
+
+/// Take up to `len` bytes of received data, without blocking.
+///
+/// Return the number of bytes taken.
+size_t serial_com1_read(uint8_t* buf, size_t len);
+
 /// Outputs a single character over COM1, once there's space in the TX buffer.
 void serial_com1_write(uint8_t data);
 
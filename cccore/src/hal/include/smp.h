@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "interrupt.h"
+#include "spinlock.h"
+#include "stivale2.h"
+
+//! Bringing up all CPUs, and data each CPU keeps for itself.
+//!
+//! The GS base of each CPU points to it's own `smp_cpu_t`, so finding it takes a single memory access.
+
+/// Most CPUs that are brought up, any beyond are left parked.
+#define SMP_CPUS_MAX 64
+
+struct ipi_call_t;
+struct vmm_address_space_t;
+
+/// Data each CPU keeps for itself.
+///
+/// Fields are owned by the subsystem their name starts with.
+struct smp_cpu_t {
+    /// The structure itself, found through the GS base.
+    struct smp_cpu_t *self;
+    /// Index into `SMP_CPUS`, the BSP being `0`.
+    size_t id;
+    /// ID of the CPU's local APIC.
+    uint32_t lapic_id;
+    /// Whether the CPU finished starting up.
+    bool online;
+    /// Frame which the ASM stub resumes once the handler of the current interrupt returns.
+    struct interrupt_isr_data_t *int_resume_frame;
+    /// Lock to release once `int_resume_unlock_frame` is resumed, if any.
+    struct ticketlock_t *int_resume_unlock;
+    /// Frame whose resumption releases `int_resume_unlock`.
+    struct interrupt_isr_data_t *int_resume_unlock_frame;
+    /// Top of the stack interrupt handlers run on, or `0` before it's allocated.
+    uintptr_t int_stack_top;
+    /// Number of interrupt handlers the CPU is in the middle of, counting nested ones.
+    uint32_t int_depth;
+    /// TID of the thread running on this CPU.
+    uint64_t thread_active_tid;
+    /// TID of this CPU's idle thread.
+    uint64_t thread_idle_tid;
+    /// When the active thread's time slice started.
+    uint64_t tickless_slice_start_ns;
+    /// Deadline this CPU's timer is currently armed for, or `0` if it has expired since.
+    uint64_t tickless_armed_deadline_ns;
+    /// Whether a more urgent thread became ready, which the active thread has to give way to right away.
+    bool tickless_preempt_pending;
+    /// Address space the CPU currently runs in.
+    struct vmm_address_space_t *vmm_active_space;
+    /// Calls other CPUs asked this one to make, indexed by the asking CPU's `id`.
+    struct ipi_call_t *ipi_calls[SMP_CPUS_MAX];
+    /// Bit `i` is set while `ipi_calls[i]` waits to be made.
+    uint64_t ipi_calls_pending;
+    /// Latest RCU grace period the CPU passed through a quiescent state in.
+    uint64_t rcu_quiescent_gp;
+};
+
+/// Per-CPU data of all CPUs that are brought up.
+extern struct smp_cpu_t SMP_CPUS[SMP_CPUS_MAX];
+
+/// Per-CPU data of the calling CPU.
+///
+/// Unless interrupts are disabled, the calling thread may be migrated to another CPU right after.
+static inline struct smp_cpu_t *smp_cpu(void) {
+    struct smp_cpu_t *cpu;
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "mov %0, gs:[0]         \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=r"(cpu));
+    return cpu;
+}
+
+/// Set up per-CPU data for all CPUs the bootloader found, and make the BSP's reachable.
+///
+/// Without the bootloader's SMP information, only the BSP is used.
+///
+/// Only call this once, on the BSP, right after `gdt_init_flat`.
+void smp_init(const struct stivale2_struct_tag_smp *smp);
+
+/// Number of CPUs that are brought up, once `smp_start_aps` is done.
+size_t smp_cpu_count(void);
+
+/// Start all application processors, one after the other, each of which calls the entry function.
+///
+/// The entry function finds it's per-CPU data set up already, and calls `smp_ap_ready` once it's done starting up.
+/// Returns once all of them did.
+void smp_start_aps(void (*entry)(void));
+
+/// Let the BSP know that the calling application processor finished starting up.
+void smp_ap_ready(void);
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//! Busy-waiting locks, for protecting data shared between CPUs.
+//!
+//! Interrupt handlers may take the same locks as threads, so threads hold them with interrupts disabled.
+//! Otherwise, an interrupt arriving while the lock is held would spin on it forever.
+//!
+//! There are three kinds, which trade simplicity for fairness under contention:
+//! - Spinlocks are a single word, but whoever happens to see it released first gets it.
+//!   All waiters hammer the same cache line, and an unlucky CPU may starve.
+//! - Ticket locks hand the lock out in the order CPUs asked for it, still spinning on a shared word.
+//! - MCS locks queue the waiters, each spinning on a node of it's own, so a release only touches one other CPU.
+//!
+//! Built with `CCCORE_LOCK_STATS`, each lock counts it's acquisitions and how many of them had to wait,
+//! and measures the longest time it was held. `lock_stats_dump` prints them for all locks taken so far.
+
+#if CCCORE_LOCK_STATS
+
+/// What a lock recorded about it's use.
+///
+/// Only updated by whoever holds the lock, so no atomics are needed.
+struct lock_stats_t {
+    /// Name for `lock_stats_dump`.
+    const char *name;
+    /// Number of times the lock was acquired.
+    uint64_t acquisitions;
+    /// Number of acquisitions that found the lock held and had to wait.
+    uint64_t contentions;
+    /// Longest time the lock was held for, in TSC ticks.
+    uint64_t max_hold_ticks;
+    /// TSC when the lock was last acquired.
+    uint64_t acquired_ticks;
+    /// Whether the lock is in the list `lock_stats_dump` walks, which it joins once it's first acquired.
+    bool registered;
+    /// Next lock in that list, if any.
+    struct lock_stats_t *next;
+};
+
+#define LOCK_STATS_INIT(lock_name) \
+    , .stats = {.name = (lock_name), .acquisitions = 0, .contentions = 0, .max_hold_ticks = 0, .registered = false}
+
+#else
+
+#define LOCK_STATS_INIT(lock_name)
+
+#endif
+
+/// A lock that CPUs spin on until it's released.
+struct spinlock_t {
+    /// `1` while held.
+    volatile uint32_t locked;
+#if CCCORE_LOCK_STATS
+    struct lock_stats_t stats;
+#endif
+};
+
+/// Initializer for a released spinlock, whose name shows up in lock statistics.
+#define SPINLOCK_INIT(lock_name) \
+    { .locked = 0 LOCK_STATS_INIT(lock_name) }
+
+/// Initialize a released spinlock, whose name shows up in lock statistics.
+void spinlock_init(struct spinlock_t *lock, const char *name);
+
+/// Spin until the lock is acquired.
+///
+/// Only use this where interrupts are disabled already.
+void spinlock_acquire(struct spinlock_t *lock);
+
+/// Release the lock.
+void spinlock_release(struct spinlock_t *lock);
+
+/// Disable interrupts, then spin until the lock is acquired.
+///
+/// Return whether interrupts were enabled before, for `spinlock_release_irqrestore`.
+bool spinlock_acquire_irqsave(struct spinlock_t *lock);
+
+/// Release the lock, then enable interrupts again if they were enabled before `spinlock_acquire_irqsave`.
+void spinlock_release_irqrestore(struct spinlock_t *lock, bool interrupts_were_enabled);
+
+/// A lock handed out in first-come, first-served order.
+struct ticketlock_t {
+    /// Ticket the next CPU to ask for the lock draws.
+    volatile uint32_t next;
+    /// Ticket of the CPU holding the lock, or which gets it next if it's released.
+    volatile uint32_t serving;
+#if CCCORE_LOCK_STATS
+    struct lock_stats_t stats;
+#endif
+};
+
+/// Initializer for a released ticket lock, whose name shows up in lock statistics.
+#define TICKETLOCK_INIT(lock_name) \
+    { .next = 0, .serving = 0 LOCK_STATS_INIT(lock_name) }
+
+/// Initialize a released ticket lock, whose name shows up in lock statistics.
+void ticketlock_init(struct ticketlock_t *lock, const char *name);
+
+/// Draw a ticket and spin until it's served.
+///
+/// Only use this where interrupts are disabled already.
+void ticketlock_acquire(struct ticketlock_t *lock);
+
+/// Acquire the lock only if it's free right now, without waiting in line.
+///
+/// Only use this where interrupts are disabled already.
+///
+/// Return whether the lock was acquired.
+bool ticketlock_try_acquire(struct ticketlock_t *lock);
+
+/// Release the lock to whoever drew the next ticket.
+void ticketlock_release(struct ticketlock_t *lock);
+
+/// Disable interrupts, then acquire the lock.
+///
+/// Return whether interrupts were enabled before, for `ticketlock_release_irqrestore`.
+bool ticketlock_acquire_irqsave(struct ticketlock_t *lock);
+
+/// Release the lock, then enable interrupts again if they were enabled before `ticketlock_acquire_irqsave`.
+void ticketlock_release_irqrestore(struct ticketlock_t *lock, bool interrupts_were_enabled);
+
+/// A CPU's place in the queue of an MCS lock.
+///
+/// Lives wherever the acquiring code likes, usually on it's stack, until the lock is released again.
+struct mcslock_node_t {
+    /// Node of the CPU which queued up next, if any.
+    struct mcslock_node_t *volatile next;
+    /// `1` while the CPU has to keep waiting.
+    volatile uint32_t waiting;
+};
+
+/// A lock whose waiters queue up, each spinning on it's own node.
+struct mcslock_t {
+    /// Node of the last CPU in the queue, NULL if the lock is released.
+    struct mcslock_node_t *volatile tail;
+#if CCCORE_LOCK_STATS
+    struct lock_stats_t stats;
+#endif
+};
+
+/// Initializer for a released MCS lock, whose name shows up in lock statistics.
+#define MCSLOCK_INIT(lock_name) \
+    { .tail = NULL LOCK_STATS_INIT(lock_name) }
+
+/// Initialize a released MCS lock, whose name shows up in lock statistics.
+void mcslock_init(struct mcslock_t *lock, const char *name);
+
+/// Queue up with the given node and spin until the lock is handed over.
+///
+/// The same node must be passed to `mcslock_release`.
+/// Only use this where interrupts are disabled already.
+void mcslock_acquire(struct mcslock_t *lock, struct mcslock_node_t *node);
+
+/// Hand the lock over to the next CPU in the queue, if any.
+void mcslock_release(struct mcslock_t *lock, struct mcslock_node_t *node);
+
+/// Disable interrupts, then acquire the lock.
+///
+/// Return whether interrupts were enabled before, for `mcslock_release_irqrestore`.
+bool mcslock_acquire_irqsave(struct mcslock_t *lock, struct mcslock_node_t *node);
+
+/// Release the lock, then enable interrupts again if they were enabled before `mcslock_acquire_irqsave`.
+void mcslock_release_irqrestore(struct mcslock_t *lock, struct mcslock_node_t *node, bool interrupts_were_enabled);
+
+/// Print the statistics of every lock that was acquired so far, if they're recorded at all.
+void lock_stats_dump(void);
@@ -14,3 +14,25 @@ typedef void (*timer_callback_t)(struct interrupt_isr_data_t* data);
 ///
 /// Also, interrupts must be enabled for the timer to work.
 void timer_enable(uint32_t tickrate_hz, timer_callback_t callback);
+
+/// Switches the timer to one-shot mode, in which it only fires once per `timer_oneshot_arm`.
+///
+/// Interrupt subsystem must be initialized before calling this.
+void timer_oneshot_enable(timer_callback_t callback);
+
+/// Sets up the one-shot timer of an application processor the same way `timer_oneshot_enable` did on the BSP.
+///
+/// Timers armed on a CPU fire on that CPU, if the hardware has a timer per CPU.
+/// Otherwise, application processors have no timer at all.
+void timer_oneshot_enable_ap(void);
+
+/// Arms the one-shot timer to fire after the given delay, replacing any pending expiry.
+///
+/// Delays longer than the hardware supports are clamped, so the timer may fire early.
+/// The callback should then simply arm it again for the remaining time.
+///
+/// Arms the calling CPU's timer. Without a timer per CPU, only the BSP's calls have an effect.
+void timer_oneshot_arm(uint64_t delay_ns);
+
+/// Monotonic time since the timer was first enabled, in nanoseconds.
+uint64_t timer_now_ns(void);
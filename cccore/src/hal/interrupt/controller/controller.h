@@ -0,0 +1,35 @@
+#pragma once
+
+//! Interface between the generic interrupt layer and the controller routing device IRQs to the CPUs.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// IDT slot the legacy ISA IRQ `0` is raised at, with the others following it.
+///
+/// Every controller keeps this layout, so drivers don't care which one is in use.
+#define CONTROLLER_ISA_VECTOR_BASE 0x20
+
+/// Number of legacy ISA IRQs.
+#define CONTROLLER_ISA_IRQS_NUM 16
+
+/// A device which routes IRQ lines to the CPUs.
+struct interrupt_controller_t {
+    const char* name;
+    /// Check whether one of the controller's lines is raised at the IDT slot.
+    bool (*manages)(uint8_t idt_slot);
+    /// Stop delivering the line raised at the IDT slot.
+    void (*mask)(uint8_t idt_slot);
+    /// Deliver the line raised at the IDT slot.
+    void (*unmask)(uint8_t idt_slot);
+    /// Signal end of interrupt for the line raised at the IDT slot.
+    void (*ack)(uint8_t idt_slot);
+    /// Deliver the line raised at the IDT slot to the CPU with the given local APIC ID.
+    /// NULL if the controller only delivers to the BSP.
+    void (*route)(uint8_t idt_slot, uint32_t lapic_id);
+};
+
+// Backends, which live in their own files.
+
+extern const struct interrupt_controller_t PIC_CONTROLLER;
+extern const struct interrupt_controller_t IOAPIC_CONTROLLER;
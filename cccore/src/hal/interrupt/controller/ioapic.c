@@ -0,0 +1,288 @@
+#include "ioapic.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common.h"
+#include "controller.h"
+#include "include/acpi.h"
+#include "include/smp.h"
+#include "include/spinlock.h"
+#include "lapic.h"
+#include "mem.h"
+
+/// Multiple APIC description table, listing the interrupt controllers after this header.
+struct __attribute__((__packed__)) madt_t {
+    struct acpi_sdt_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+};
+
+/// Header of each entry in the MADT.
+struct __attribute__((__packed__)) madt_entry_t {
+    uint8_t type;
+    /// Size of the whole entry, including this header.
+    uint8_t length;
+};
+
+enum madt_entry_type_t {
+    MADT_ENTRY_IOAPIC = 1,
+    MADT_ENTRY_SOURCE_OVERRIDE = 2,
+};
+
+struct __attribute__((__packed__)) madt_ioapic_t {
+    struct madt_entry_t entry;
+    uint8_t id;
+    uint8_t reserved;
+    uint32_t address;
+    /// First global system interrupt the I/O APIC's pins deliver.
+    uint32_t gsi_base;
+};
+
+/// An ISA IRQ wired to another GSI than the one of the same number, or with a different polarity or trigger mode.
+struct __attribute__((__packed__)) madt_source_override_t {
+    struct madt_entry_t entry;
+    /// Always `0`, which is ISA.
+    uint8_t bus;
+    uint8_t source;
+    uint32_t gsi;
+    uint16_t flags;
+};
+
+/// Polarity and trigger mode in the flags of an interrupt source override, where `0` means as is usual for the bus.
+static const uint16_t OVERRIDE_POLARITY_MASK = 0b0011;
+static const uint16_t OVERRIDE_POLARITY_LOW = 0b0011;
+static const uint16_t OVERRIDE_TRIGGER_MASK = 0b1100;
+static const uint16_t OVERRIDE_TRIGGER_LEVEL = 0b1100;
+
+/// Indices of the register select and data window, which all other registers are accessed through.
+static const size_t IOREGSEL = 0x00 / sizeof(uint32_t);
+static const size_t IOWIN = 0x10 / sizeof(uint32_t);
+
+enum ioapic_reg_t {
+    IOAPIC_REG_VERSION = 0x01,
+    /// Low half of the first redirection entry, each being two registers.
+    IOAPIC_REG_REDIRECTION = 0x10,
+};
+
+/// Flags in the low half of a redirection entry, whose lowest byte is the vector.
+/// Fixed delivery mode to a physical destination is all zeroes.
+static const uint32_t REDIRECTION_ACTIVE_LOW = 1 << 13;
+static const uint32_t REDIRECTION_LEVEL = 1 << 15;
+static const uint32_t REDIRECTION_MASKED = 1 << 16;
+
+/// Where the destination's local APIC ID lies in the high half of a redirection entry.
+static const uint32_t REDIRECTION_DEST_SHIFT = 24;
+
+/// Most I/O APICs that are used, pins of any beyond are never unmasked.
+#define IOAPICS_MAX 8
+
+struct ioapic_t {
+    volatile uint32_t *base;
+    uint32_t gsi_base;
+    uint32_t pins_num;
+};
+
+static struct ioapic_t IOAPICS[IOAPICS_MAX];
+static size_t IOAPICS_NUM = 0;
+
+/// The I/O APIC pin an ISA IRQ ends up at.
+struct isa_line_t {
+    /// NULL if no I/O APIC has the IRQ's GSI, in which case it's never delivered.
+    struct ioapic_t *ioapic;
+    uint32_t gsi;
+    uint32_t pin;
+    /// Polarity and trigger mode flags for the redirection entry.
+    uint32_t flags;
+};
+
+static struct isa_line_t ISA_LINES[CONTROLLER_ISA_IRQS_NUM];
+
+/// Protects the register select of all I/O APICs, which is shared by all CPUs.
+static struct spinlock_t IOAPIC_LOCK = SPINLOCK_INIT("ioapic");
+
+/// Only call this with `IOAPIC_LOCK` held.
+static uint32_t reg_read(struct ioapic_t *ioapic, uint32_t reg) {
+    ioapic->base[IOREGSEL] = reg;
+    return ioapic->base[IOWIN];
+}
+
+/// Only call this with `IOAPIC_LOCK` held.
+static void reg_write(struct ioapic_t *ioapic, uint32_t reg, uint32_t value) {
+    ioapic->base[IOREGSEL] = reg;
+    ioapic->base[IOWIN] = value;
+}
+
+static uint32_t redirection_low(uint32_t pin) { return IOAPIC_REG_REDIRECTION + pin * 2; }
+
+static uint32_t redirection_high(uint32_t pin) { return IOAPIC_REG_REDIRECTION + pin * 2 + 1; }
+
+/// Find the I/O APIC delivering the GSI.
+///
+/// Return NULL if none does.
+static struct ioapic_t *ioapic_find(uint32_t gsi) {
+    for (size_t i = 0; i < IOAPICS_NUM; i++) {
+        if (gsi >= IOAPICS[i].gsi_base && gsi - IOAPICS[i].gsi_base < IOAPICS[i].pins_num) {
+            return &IOAPICS[i];
+        }
+    }
+    return NULL;
+}
+
+static void isa_line_set(uint8_t irq, uint32_t gsi, uint32_t flags) {
+    struct isa_line_t *line = &ISA_LINES[irq];
+    line->ioapic = ioapic_find(gsi);
+    line->gsi = gsi;
+    line->pin = line->ioapic != NULL ? gsi - line->ioapic->gsi_base : 0;
+    line->flags = flags;
+}
+
+/// Convert the flags of an interrupt source override into the ones of a redirection entry.
+static uint32_t override_flags(uint16_t flags) {
+    // ISA IRQs are active high and edge triggered, unless the override says otherwise
+    uint32_t redirection = 0;
+    if ((flags & OVERRIDE_POLARITY_MASK) == OVERRIDE_POLARITY_LOW) {
+        redirection |= REDIRECTION_ACTIVE_LOW;
+    }
+    if ((flags & OVERRIDE_TRIGGER_MASK) == OVERRIDE_TRIGGER_LEVEL) {
+        redirection |= REDIRECTION_LEVEL;
+    }
+    return redirection;
+}
+
+/// Call the function for every MADT entry of the given type.
+static void madt_entries_walk(const struct madt_t *madt, enum madt_entry_type_t type,
+                              void (*func)(const struct madt_entry_t *entry)) {
+    const uint8_t *entry = (const uint8_t *)madt + sizeof(*madt);
+    const uint8_t *const end = (const uint8_t *)madt + madt->header.length;
+    while (entry + sizeof(struct madt_entry_t) <= end) {
+        const struct madt_entry_t *header = (const struct madt_entry_t *)entry;
+        if (header->length < sizeof(struct madt_entry_t) || entry + header->length > end) {
+            break;
+        }
+        if (header->type == type) {
+            func(header);
+        }
+        entry += header->length;
+    }
+}
+
+static void ioapic_add(const struct madt_entry_t *entry) {
+    const struct madt_ioapic_t *info = (const struct madt_ioapic_t *)entry;
+    if (IOAPICS_NUM == IOAPICS_MAX) {
+        kprintf("%s: Ignoring I/O APIC %u, too many\n", __func__, info->id);
+        return;
+    }
+    struct ioapic_t *ioapic = &IOAPICS[IOAPICS_NUM];
+    ioapic->base = mem_phys_to_virt(info->address);
+    ioapic->gsi_base = info->gsi_base;
+    ioapic->pins_num = ((reg_read(ioapic, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+    IOAPICS_NUM++;
+}
+
+static void source_override_apply(const struct madt_entry_t *entry) {
+    const struct madt_source_override_t *override = (const struct madt_source_override_t *)entry;
+    if (override->bus != 0 || override->source >= CONTROLLER_ISA_IRQS_NUM) {
+        return;
+    }
+    isa_line_set(override->source, override->gsi, override_flags(override->flags));
+
+    // Some other IRQ's GSI of the same number is taken then, which is usually IRQ 2 giving way to the PIT
+    for (uint8_t irq = 0; irq < CONTROLLER_ISA_IRQS_NUM; irq++) {
+        if (irq != override->source && ISA_LINES[irq].gsi == override->gsi) {
+            ISA_LINES[irq].ioapic = NULL;
+        }
+    }
+}
+
+int ioapic_init(void) {
+    const struct madt_t *madt = (const struct madt_t *)acpi_table_find("APIC");
+    if (madt == NULL) {
+        return -1;
+    }
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&IOAPIC_LOCK);
+    madt_entries_walk(madt, MADT_ENTRY_IOAPIC, ioapic_add);
+    if (IOAPICS_NUM == 0) {
+        spinlock_release_irqrestore(&IOAPIC_LOCK, interrupts_were_enabled);
+        return -1;
+    }
+
+    // The firmware may have left pins set up, which nobody handles
+    for (size_t i = 0; i < IOAPICS_NUM; i++) {
+        for (uint32_t pin = 0; pin < IOAPICS[i].pins_num; pin++) {
+            reg_write(&IOAPICS[i], redirection_low(pin), REDIRECTION_MASKED);
+        }
+    }
+
+    for (uint8_t irq = 0; irq < CONTROLLER_ISA_IRQS_NUM; irq++) {
+        isa_line_set(irq, irq, 0);
+    }
+    madt_entries_walk(madt, MADT_ENTRY_SOURCE_OVERRIDE, source_override_apply);
+
+    // Only the BSP is running, and it's the one the PIC delivered to as well
+    const uint32_t dest = SMP_CPUS[0].lapic_id << REDIRECTION_DEST_SHIFT;
+    for (uint8_t irq = 0; irq < CONTROLLER_ISA_IRQS_NUM; irq++) {
+        struct isa_line_t *line = &ISA_LINES[irq];
+        if (line->ioapic != NULL) {
+            const uint32_t vector = CONTROLLER_ISA_VECTOR_BASE + irq;
+            reg_write(line->ioapic, redirection_high(line->pin), dest);
+            reg_write(line->ioapic, redirection_low(line->pin), REDIRECTION_MASKED | line->flags | vector);
+        }
+    }
+    spinlock_release_irqrestore(&IOAPIC_LOCK, interrupts_were_enabled);
+    return 0;
+}
+
+/// Find the line raised at the IDT slot.
+///
+/// Return NULL if it isn't one of the ISA IRQs, or no I/O APIC delivers it.
+static struct isa_line_t *isa_line_find(uint8_t idt_slot) {
+    if (idt_slot < CONTROLLER_ISA_VECTOR_BASE || idt_slot >= CONTROLLER_ISA_VECTOR_BASE + CONTROLLER_ISA_IRQS_NUM) {
+        return NULL;
+    }
+    struct isa_line_t *line = &ISA_LINES[idt_slot - CONTROLLER_ISA_VECTOR_BASE];
+    return line->ioapic != NULL ? line : NULL;
+}
+
+static bool controller_manages(uint8_t idt_slot) { return isa_line_find(idt_slot) != NULL; }
+
+static void mask_set(uint8_t idt_slot, bool masked) {
+    struct isa_line_t *line = isa_line_find(idt_slot);
+    if (line == NULL) {
+        return;
+    }
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&IOAPIC_LOCK);
+    const uint32_t low = reg_read(line->ioapic, redirection_low(line->pin));
+    reg_write(line->ioapic, redirection_low(line->pin), masked ? low | REDIRECTION_MASKED : low & ~REDIRECTION_MASKED);
+    spinlock_release_irqrestore(&IOAPIC_LOCK, interrupts_were_enabled);
+}
+
+static void controller_mask(uint8_t idt_slot) { mask_set(idt_slot, true); }
+
+static void controller_unmask(uint8_t idt_slot) { mask_set(idt_slot, false); }
+
+/// Level triggered lines are rearmed by the local APIC broadcasting the EOI to the I/O APICs.
+static void controller_ack(uint8_t idt_slot) {
+    (void)idt_slot;
+    lapic_eoi();
+}
+
+static void controller_route(uint8_t idt_slot, uint32_t lapic_id) {
+    struct isa_line_t *line = isa_line_find(idt_slot);
+    if (line == NULL) {
+        return;
+    }
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&IOAPIC_LOCK);
+    reg_write(line->ioapic, redirection_high(line->pin), lapic_id << REDIRECTION_DEST_SHIFT);
+    spinlock_release_irqrestore(&IOAPIC_LOCK, interrupts_were_enabled);
+}
+
+const struct interrupt_controller_t IOAPIC_CONTROLLER = {
+    .name = "I/O APIC",
+    .manages = controller_manages,
+    .mask = controller_mask,
+    .unmask = controller_unmask,
+    .ack = controller_ack,
+    .route = controller_route,
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+/// Find the I/O APICs in the ACPI MADT, and set them up to deliver the legacy ISA IRQs to the BSP.
+///
+/// All lines start out masked, like with the PIC.
+/// The ACPI tables must have been located, and the BSP's local APIC enabled.
+///
+/// Return `-1` if there's no MADT or it lists no I/O APIC, in which case nothing was touched.
+///
+/// Return `0` on success.
+int ioapic_init(void);
@@ -0,0 +1,64 @@
+#include "lapic.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "include/cpu.h"
+#include "include/interrupt.h"
+#include "mem.h"
+
+/// MSR holding the local APIC's physical base address and global enable flag.
+static const uint32_t MSR_APIC_BASE = 0x1B;
+static const uint64_t MSR_APIC_BASE_ENABLE = 1 << 11;
+static const uint64_t MSR_APIC_BASE_ADDR_MASK = 0x000FFFFFFFFFF000;
+
+/// CPUID leaf 1 EDX flag signaling presence of a local APIC.
+static const uint32_t CPUID_1_EDX_APIC = 1 << 9;
+
+/// Software enable flag in the spurious interrupt vector register.
+static const uint32_t SPURIOUS_ENABLE = 1 << 8;
+
+/// Flags in the low half of the interrupt command register.
+static const uint32_t ICR_DELIVERY_PENDING = 1 << 12;
+static const uint32_t ICR_LEVEL_ASSERT = 1 << 14;
+
+/// Where the local APIC's registers are mapped, which is within the direct map.
+static volatile uint32_t* LAPIC_BASE = NULL;
+
+bool lapic_present(void) { return (cpu_cpuid(1, 0).edx & CPUID_1_EDX_APIC) != 0; }
+
+uint32_t lapic_read(enum lapic_reg_t reg) { return LAPIC_BASE[reg / sizeof(uint32_t)]; }
+
+void lapic_write(enum lapic_reg_t reg, uint32_t value) { LAPIC_BASE[reg / sizeof(uint32_t)] = value; }
+
+void lapic_eoi(void) { lapic_write(LAPIC_REG_EOI, 0); }
+
+uint8_t lapic_id(void) { return (uint8_t)(lapic_read(LAPIC_REG_ID) >> 24); }
+
+/// Wait until the previous IPI was accepted, so that the interrupt command register may be written again.
+static void ipi_wait_sent(void) {
+    while ((lapic_read(LAPIC_REG_ICR_LOW) & ICR_DELIVERY_PENDING) != 0) {
+        __builtin_ia32_pause();
+    }
+}
+
+void lapic_ipi(uint8_t dest_lapic_id, uint8_t vector) {
+    ipi_wait_sent();
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)dest_lapic_id << 24);
+    // Writing the low half sends it, in fixed delivery mode to a physical destination
+    lapic_write(LAPIC_REG_ICR_LOW, ICR_LEVEL_ASSERT | vector);
+}
+
+/// Spurious interrupts must not be acknowledged, so there's nothing to do.
+static void spurious_isr(struct interrupt_isr_data_t* data) { (void)data; }
+
+void lapic_enable(void) {
+    const uint64_t apic_base = cpu_rdmsr(MSR_APIC_BASE);
+    cpu_wrmsr(MSR_APIC_BASE, apic_base | MSR_APIC_BASE_ENABLE);
+    LAPIC_BASE = (volatile uint32_t*)mem_phys_to_virt(apic_base & MSR_APIC_BASE_ADDR_MASK);
+
+    interrupt_register(spurious_isr, LAPIC_SPURIOUS_VECTOR);
+    // The LINT pins keep their firmware configuration, so legacy PIC interrupts still get through
+    lapic_write(LAPIC_REG_SPURIOUS, SPURIOUS_ENABLE | LAPIC_SPURIOUS_VECTOR);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Registers of the local APIC, as offsets from it's base address.
+enum lapic_reg_t {
+    LAPIC_REG_ID = 0x20,
+    LAPIC_REG_EOI = 0xB0,
+    LAPIC_REG_SPURIOUS = 0xF0,
+    LAPIC_REG_ICR_LOW = 0x300,
+    LAPIC_REG_ICR_HIGH = 0x310,
+    LAPIC_REG_LVT_TIMER = 0x320,
+    LAPIC_REG_TIMER_INITIAL_COUNT = 0x380,
+    LAPIC_REG_TIMER_CURRENT_COUNT = 0x390,
+    LAPIC_REG_TIMER_DIVIDE = 0x3E0,
+};
+
+/// Vector the local APIC raises for spurious interrupts.
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+/// Check whether the CPU has a local APIC.
+bool lapic_present(void);
+
+/// Enable the local APIC of the calling CPU.
+///
+/// Interrupt subsystem must be initialized before calling this.
+void lapic_enable(void);
+
+/// Read a local APIC register.
+uint32_t lapic_read(enum lapic_reg_t reg);
+
+/// Write a local APIC register.
+void lapic_write(enum lapic_reg_t reg, uint32_t value);
+
+/// Signal end of interrupt to the local APIC.
+void lapic_eoi(void);
+
+/// Get the ID of the calling CPU's local APIC.
+uint8_t lapic_id(void);
+
+/// Send an inter-processor interrupt with the given vector to the CPU with the given local APIC ID.
+///
+/// Only use this where interrupts are disabled, as an interrupt handler sending one in between would
+/// overwrite the destination.
+void lapic_ipi(uint8_t dest_lapic_id, uint8_t vector);
@@ -3,14 +3,16 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "controller.h"
 #include "include/io_port.h"
+#include "include/spinlock.h"
 
 // TODO: Remove
 #include "../../common.h"
 
 // Where the PIC chips are remapped to.
 // Intel reserves vectors up to 0x1F for CPU-internal exceptions, so start right above that range.
-static const uint8_t PIC1_VECTOR_BASE = 0x20;
+static const uint8_t PIC1_VECTOR_BASE = CONTROLLER_ISA_VECTOR_BASE;
 static const uint8_t PIC2_VECTOR_BASE = 0x28;
 
 // I/O ports used to program legacy PIC.
@@ -48,20 +50,38 @@ enum pic_cmd_t {
     PIC_CMD_READ_ISR = 0x0B,
 };
 
+static struct spinlock_t PIC_LOCK = SPINLOCK_INIT("pic");
+
+/// Bit `i` is set while IRQ `i` is masked, starting out with all masked.
+///
+/// Kept in memory rather than read from the PICs, so that lines unmasked before `pic_enable` stay unmasked.
+static uint16_t PIC_MASK = 0xFFFF;
+
+/// Whether the PICs deliver interrupts, rather than having been replaced by another controller.
+static bool PIC_ENABLED = false;
+
+/// Write `PIC_MASK` to both PICs, unless they're disabled.
+///
+/// Only call this with `PIC_LOCK` held.
+static void mask_write(void) {
+    if (PIC_ENABLED) {
+        // The cascade from PIC2 stays unmasked, or none of it's IRQs would get through
+        port_write_u8(PIC1_PORT_DATA, (uint8_t)(PIC_MASK & ~PIC1_PIC2_IRQ));
+        port_write_u8(PIC2_PORT_DATA, (uint8_t)(PIC_MASK >> 8));
+    }
+}
+
 uint8_t pic_irq_to_idt_slot(uint8_t irq) { return PIC1_VECTOR_BASE + irq; }
 
 uint8_t pic_idt_slot_to_irq(uint8_t idt_slot) { return idt_slot - PIC1_VECTOR_BASE; }
 
 void pic_enable(void) {
     // TODO: Real HW might require wait after each I/O
-
-    // Save mask stating which IRQs are active
-    const uint8_t mask_1 = port_read_u8(PIC1_PORT_DATA);
-    const uint8_t mask_2 = port_read_u8(PIC2_PORT_DATA);
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&PIC_LOCK);
 
     // Start cascade init
     port_write_u8(PIC1_PORT_CMD, PIC_ICW1_INIT | PIC_ICW1_ICW4_NEEDED | PIC_ICW1_MODE_CASCADE);
-    port_write_u8(PIC1_PORT_CMD, PIC_ICW1_INIT | PIC_ICW1_ICW4_NEEDED | PIC_ICW1_MODE_CASCADE);
+    port_write_u8(PIC2_PORT_CMD, PIC_ICW1_INIT | PIC_ICW1_ICW4_NEEDED | PIC_ICW1_MODE_CASCADE);
 
     // Tell PICs where to start their IRQs in CPU's IVT
     port_write_u8(PIC1_PORT_DATA, PIC1_VECTOR_BASE);
@@ -75,42 +95,42 @@ void pic_enable(void) {
     port_write_u8(PIC1_PORT_DATA, PIC_ICW4_8086);
     port_write_u8(PIC2_PORT_DATA, PIC_ICW4_8086);
 
-    // Restore mask of active IRQs
-    port_write_u8(PIC1_PORT_DATA, mask_1);
-    port_write_u8(PIC2_PORT_DATA, mask_2);
+    // Only deliver the IRQs drivers asked for, whatever the firmware left unmasked
+    PIC_ENABLED = true;
+    mask_write();
+    spinlock_release_irqrestore(&PIC_LOCK, interrupts_were_enabled);
 }
 
 void pic_disable(void) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&PIC_LOCK);
+    PIC_ENABLED = false;
     port_write_u8(PIC1_PORT_DATA, PIC_CMD_DISABLE);
     port_write_u8(PIC2_PORT_DATA, PIC_CMD_DISABLE);
+    spinlock_release_irqrestore(&PIC_LOCK, interrupts_were_enabled);
 }
 
 void pic_unmask(uint8_t irq) {
-    uint16_t port;
-    if (irq < 8) {
-        port = PIC1_PORT_DATA;
-    } else if (irq < 16) {
-        port = PIC2_PORT_DATA;
-    } else {
+    if (irq >= 16) {
         kpanicf("PIC: Attempt to unmask invalid IRQ");
     }
-    const uint8_t mask = port_read_u8(port) & ~(1 << irq);
-    port_write_u8(port, mask);
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&PIC_LOCK);
+    PIC_MASK &= (uint16_t)~(1 << irq);
+    mask_write();
+    spinlock_release_irqrestore(&PIC_LOCK, interrupts_were_enabled);
 }
 
 void pic_mask(uint8_t irq) {
-    uint16_t port;
-    if (irq < 8) {
-        port = PIC1_PORT_DATA;
-    } else if (irq < 16) {
-        port = PIC2_PORT_DATA;
-    } else {
+    if (irq >= 16) {
         kpanicf("PIC: Attempt to mask invalid IRQ");
     }
-    const uint8_t mask = port_read_u8(port) | (1 << irq);
-    port_write_u8(port, mask);
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&PIC_LOCK);
+    PIC_MASK |= (uint16_t)(1 << irq);
+    mask_write();
+    spinlock_release_irqrestore(&PIC_LOCK, interrupts_were_enabled);
 }
 
+bool pic_masked(uint8_t irq) { return (__atomic_load_n(&PIC_MASK, __ATOMIC_RELAXED) & (1 << irq)) != 0; }
+
 void pic_ack(uint8_t irq) {
     // If on PIC1 ack only there, otherwise on both
     if (irq >= 8) {
@@ -134,3 +154,19 @@ uint16_t pic_get_isr(void) {
     port_write_u8(PIC2_PORT_CMD, PIC_CMD_READ_ISR);
     return (port_read_u8(PIC1_PORT_CMD) << 8) | port_read_u8(PIC2_PORT_CMD);
 }
+
+static void controller_mask(uint8_t idt_slot) { pic_mask(pic_idt_slot_to_irq(idt_slot)); }
+
+static void controller_unmask(uint8_t idt_slot) { pic_unmask(pic_idt_slot_to_irq(idt_slot)); }
+
+static void controller_ack(uint8_t idt_slot) { pic_ack(pic_idt_slot_to_irq(idt_slot)); }
+
+const struct interrupt_controller_t PIC_CONTROLLER = {
+    .name = "8259 PIC",
+    .manages = pic_idt_is_managed,
+    .mask = controller_mask,
+    .unmask = controller_unmask,
+    .ack = controller_ack,
+    // Wired to the BSP's LINT0
+    .route = NULL,
+};
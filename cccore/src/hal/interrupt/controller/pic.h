@@ -3,7 +3,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-/// Enable the PICs.
+/// Enable the PICs, with all lines masked but those unmasked before.
 void pic_enable(void);
 
 /// Disable the PICs.
@@ -15,6 +15,9 @@ void pic_mask(uint8_t irq);
 /// Unmask (enable) a particular IRQ.
 void pic_unmask(uint8_t irq);
 
+/// Check whether a particular IRQ is masked.
+bool pic_masked(uint8_t irq);
+
 /// Acknowledge a particular IRQ.
 void pic_ack(uint8_t irq);
 
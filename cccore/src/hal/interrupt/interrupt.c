@@ -4,8 +4,17 @@
 #include <stdint.h>
 
 #include "../../common.h"
+#include "controller/controller.h"
+#include "controller/ioapic.h"
+#include "controller/lapic.h"
 #include "controller/pic.h"
 #include "gdt.h"
+#include "include/acpi.h"
+#include "include/rcu.h"
+#include "include/smp.h"
+#include "include/spinlock.h"
+#include "mem.h"
+#include "pmm.h"
 
 /// Selector that tells CPU how to look up a segment for an IDT.
 typedef uint16_t idt_selector_t;
@@ -36,6 +45,9 @@ static const uint8_t TYPE_ATTR_INTERRUPT_PROTECTION_RING0 = 0b00000000;
 static const idt_selector_t SELECTOR_PRIVILEGE_RING0 = 0b0000000000000000;
 static const idt_selector_t SELECTOR_TABLE_GDT = 0b0000000000000000;
 
+/// Interrupt enable flag in RFLAGS.
+static const uint64_t RFLAGS_IF = 1 << 9;
+
 #define IDT_NUM_ENTRIES 256
 static __attribute__((aligned(16))) struct idt_entry_t IDT[IDT_NUM_ENTRIES];
 static __attribute__((aligned(16))) __attribute__((used)) struct idt_info_t IDT_INFO = {
@@ -44,15 +56,79 @@ static __attribute__((aligned(16))) __attribute__((used)) struct idt_info_t IDT_
 };
 
 /// This table stores C interrupt handlers, if defined.
+///
+/// Read on every interrupt, so it's protected by RCU rather than a lock.
 static interrupt_isr_t INT_HANDLERS[IDT_NUM_ENTRIES];
 
-/// This table stores addresses of ASM stubs.
-/// These are actually written into the IDT.
-extern uintptr_t ISR_TABLE[IDT_NUM_ENTRIES];
+// Exceptions that get a stack of their own, switched to by the CPU itself.
+static const uint8_t EXCEPTION_NMI = 2;
+static const uint8_t EXCEPTION_DOUBLE_FAULT = 8;
+static const uint8_t EXCEPTION_PAGE_FAULT = 14;
+static const uint8_t EXCEPTION_MACHINE_CHECK = 18;
+
+/// Entries of the interrupt stack table, where `IST_NONE` keeps using the current stack.
+enum ist_t {
+    IST_NONE = 0,
+    IST_NMI = 1,
+    IST_DOUBLE_FAULT = 2,
+    IST_MACHINE_CHECK = 3,
+    IST_PAGE_FAULT = 4,
+};
+
+/// Number of entries of the interrupt stack table that are used.
+#define IST_USED_NUM 4
+
+/// Order of each of a CPU's interrupt stacks, which are the IRQ stack and one per used IST entry.
+#define INTERRUPT_STACK_ORDER 2
+#define INTERRUPT_STACK_SIZE (MEM_PAGE_SIZE << INTERRUPT_STACK_ORDER)
+
+/// How far below it's top an IST stack continues while a handler runs on it.
+///
+/// The CPU always switches to the IST entry's stack top, so a nested exception of the same vector, like a fault
+/// within the page fault handler, would otherwise overwrite the outer handler's stack.
+#define IST_NESTED_OFFSET (INTERRUPT_STACK_SIZE / 2)
+
+/// Top of each CPU's stack for each used IST entry, `IST_TOPS[cpu][ist - 1]`.
+static uintptr_t IST_TOPS[SMP_CPUS_MAX][GDT_IST_NUM];
+
+/// Bit `i % 64` of entry `i / 64` is set while interrupts at IDT slot `i` are traced.
+///
+/// Checked on every interrupt, so tracing costs nothing but a load while it's off.
+static uint64_t INT_TRACED[IDT_NUM_ENTRIES / 64];
+
+/// ASM stubs generated by `isr.py`, one per IDT slot and each `ISR_STUB_SIZE` bytes long.
+/// Their addresses are actually written into the IDT.
+extern const char ISR_STUBS[];
+#define ISR_STUB_SIZE 8
+
+/// Call the handler on the stack ending at the given top, and return to the calling stack afterwards.
+extern void interrupt_stack_call(interrupt_isr_t isr, struct interrupt_isr_data_t* data, uintptr_t stack_top);
+
+/// Controller the ISA IRQs go through, which is the PIC unless `interrupt_controller_init` finds I/O APICs.
+static const struct interrupt_controller_t* CONTROLLER = &PIC_CONTROLLER;
+
+/// IDT slots handed out for message-signalled interrupts, which lie between the ISA IRQs' and the IPC syscall's.
+#define MSI_VECTOR_BASE 0x40
+#define MSI_VECTORS_NUM 64
+
+/// Bit `i` is set while IDT slot `MSI_VECTOR_BASE + i` is taken.
+static uint64_t MSI_TAKEN = 0;
+static struct spinlock_t MSI_LOCK = SPINLOCK_INIT("msi");
+
+/// Address range message-signalled interrupts are written to, with the destination's local APIC ID in bits 12 to 19.
+static const uint64_t MSI_ADDRESS_BASE = 0xFEE00000;
+static const uint32_t MSI_ADDRESS_DEST_SHIFT = 12;
 
 /// Construct a selector into the GDT for use in an IDT entry.
 static idt_selector_t idt_selector_create(void) { return SELECTOR_PRIVILEGE_RING0 | SELECTOR_TABLE_GDT | GDT_CODE_IDX; }
 
+static void idt_load(void) {
+    __asm__ volatile(
+        ".intel_syntax noprefix  \n\t"
+        "lidt [IDT_INFO]         \n\t"
+        ".att_syntax prefix      \n\t");
+}
+
 /// Register the ASM trampoline for a particular ISR in the IDT.
 /// This is only called once for each IDT slot.
 static void idt_register(uintptr_t asm_isr, uint8_t idt_slot) {
@@ -62,26 +138,20 @@ static void idt_register(uintptr_t asm_isr, uint8_t idt_slot) {
         .offset_1 = (uint16_t)(isr_addr & 0x000000000000FFFF),
         .offset_2 = (uint16_t)((isr_addr & 0x00000000FFFF0000) >> 16),
         .offset_3 = (uint32_t)((isr_addr & 0xFFFFFFFF00000000) >> 32),
-        // Interrupt stack table unused for now
-        .ist = 0,
+        // Set by `interrupt_stacks_init` for the exceptions that need it
+        .ist = IST_NONE,
         .type_and_attr = TYPE_ATTR_INTERRUPT_64 | TYPE_ATTR_INTERRUPT_PRESENT | TYPE_ATTR_INTERRUPT_PROTECTION_RING0,
         .reserved_zeroed = 0,
         .selector = idt_selector_create(),
     };
 
     IDT[idt_slot] = d;
-
-    // If the interrupt falls within the range administered by the PIC, program it as well
-    // TODO: Is this really the most appropriate place for this?
-    if (pic_idt_is_managed(idt_slot)) {
-        pic_unmask(pic_idt_slot_to_irq(idt_slot));
-    };
 }
 
 void interrupt_init(void) {
     // Initialize entire table with the ASM stub for each interrupt
     for (size_t i = 0; i < IDT_NUM_ENTRIES; i++) {
-        idt_register(ISR_TABLE[i], (uint8_t)i);
+        idt_register((uintptr_t)&ISR_STUBS[i * ISR_STUB_SIZE], (uint8_t)i);
     };
 
     // No C handlers have been defined yet; clear the table
@@ -89,25 +159,192 @@ void interrupt_init(void) {
         INT_HANDLERS[i] = NULL;
     };
 
-    __asm__ volatile(
-        ".intel_syntax noprefix  \n\t"
-        "lidt [IDT_INFO]         \n\t"
-        ".att_syntax prefix      \n\t");
+    idt_load();
 
-    // For now, we only support legacy PIC. Therefore, initialize it unconditionally.
+    // The PIC is there on every PC, until `interrupt_controller_init` finds something better.
+    // Lines stay masked until their drivers unmask them.
     pic_enable();
     // TODO: Install handler for spurious PIC interrupts
 }
 
-void interrupt_register(interrupt_isr_t isr, uint8_t idt_slot) { INT_HANDLERS[(size_t)idt_slot] = isr; }
+void interrupt_init_ap(void) {
+    // Before the IDT, whose entries already select the stacks it holds
+    gdt_tss_load();
+    idt_load();
+}
+
+/// Find the IST entry whose stack the CPU switches to for the IDT slot.
+static enum ist_t ist_of(uint8_t idt_slot) {
+    if (idt_slot == EXCEPTION_NMI) {
+        return IST_NMI;
+    }
+    if (idt_slot == EXCEPTION_DOUBLE_FAULT) {
+        return IST_DOUBLE_FAULT;
+    }
+    if (idt_slot == EXCEPTION_MACHINE_CHECK) {
+        return IST_MACHINE_CHECK;
+    }
+    if (idt_slot == EXCEPTION_PAGE_FAULT) {
+        return IST_PAGE_FAULT;
+    }
+    return IST_NONE;
+}
+
+/// Allocate one of the CPU's interrupt stacks.
+///
+/// Return it's top.
+static uintptr_t stack_alloc(size_t cpu) {
+    uintptr_t phys;
+    if (pmm_alloc(INTERRUPT_STACK_ORDER, &phys) != 0) {
+        kpanicf("%s: Failed to allocate interrupt stack for CPU %lu\n", __func__, cpu);
+    }
+    return (uintptr_t)mem_phys_to_virt(phys) + INTERRUPT_STACK_SIZE;
+}
+
+void interrupt_stacks_init(void) {
+    for (size_t cpu = 0; cpu < smp_cpu_count(); cpu++) {
+        SMP_CPUS[cpu].int_stack_top = stack_alloc(cpu);
+        for (size_t i = 0; i < IST_USED_NUM; i++) {
+            IST_TOPS[cpu][i] = stack_alloc(cpu);
+        }
+        gdt_tss_init(cpu, IST_TOPS[cpu]);
+    }
+    gdt_tss_load();
+
+    // Only once the BSP's TSS holds the stacks, application processors load theirs before the IDT
+    for (size_t i = 0; i < IDT_NUM_ENTRIES; i++) {
+        IDT[i].ist = ist_of((uint8_t)i);
+    }
+}
+
+void interrupt_controller_init(const struct stivale2_struct_tag_rsdp* rsdp) {
+    acpi_init(rsdp);
+    // The I/O APICs deliver through the local APICs, so there's no point without one
+    if (lapic_present() && ioapic_init() == 0) {
+        pic_disable();
+        // Drivers set up before keep their lines, now delivered by the I/O APIC instead
+        for (uint8_t irq = 0; irq < CONTROLLER_ISA_IRQS_NUM; irq++) {
+            if (!pic_masked(irq)) {
+                IOAPIC_CONTROLLER.unmask(interrupt_irq_to_idt_slot(irq));
+            }
+        }
+        CONTROLLER = &IOAPIC_CONTROLLER;
+    }
+    kprintf("Interrupt controller: %s\n", CONTROLLER->name);
+}
+
+uint8_t interrupt_irq_to_idt_slot(uint8_t irq) { return CONTROLLER_ISA_VECTOR_BASE + irq; }
+
+void interrupt_mask(uint8_t idt_slot) {
+    if (CONTROLLER->manages(idt_slot)) {
+        CONTROLLER->mask(idt_slot);
+    }
+}
+
+void interrupt_unmask(uint8_t idt_slot) {
+    if (CONTROLLER->manages(idt_slot)) {
+        CONTROLLER->unmask(idt_slot);
+    }
+}
+
+int interrupt_route(uint8_t idt_slot, size_t cpu) {
+    if (!CONTROLLER->manages(idt_slot) || CONTROLLER->route == NULL || cpu >= smp_cpu_count()) {
+        return -1;
+    }
+    CONTROLLER->route(idt_slot, SMP_CPUS[cpu].lapic_id);
+    return 0;
+}
+
+static bool msi_is_managed(uint8_t idt_slot) {
+    return idt_slot >= MSI_VECTOR_BASE && idt_slot < MSI_VECTOR_BASE + MSI_VECTORS_NUM;
+}
+
+int interrupt_msi_alloc(size_t cpu, uint8_t* idt_slot, struct interrupt_msi_t* msi) {
+    if (!lapic_present() || cpu >= smp_cpu_count()) {
+        return -1;
+    }
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&MSI_LOCK);
+    if (MSI_TAKEN == UINT64_MAX) {
+        spinlock_release_irqrestore(&MSI_LOCK, interrupts_were_enabled);
+        return -1;
+    }
+    const size_t bit = (size_t)__builtin_ctzll(~MSI_TAKEN);
+    MSI_TAKEN |= (uint64_t)1 << bit;
+    spinlock_release_irqrestore(&MSI_LOCK, interrupts_were_enabled);
+
+    // Fixed delivery of an edge triggered interrupt to a physical destination is all zeroes apart from the vector
+    *idt_slot = (uint8_t)(MSI_VECTOR_BASE + bit);
+    msi->address = MSI_ADDRESS_BASE | ((uint64_t)SMP_CPUS[cpu].lapic_id << MSI_ADDRESS_DEST_SHIFT);
+    msi->data = *idt_slot;
+    return 0;
+}
+
+void interrupt_msi_free(uint8_t idt_slot) {
+    if (!msi_is_managed(idt_slot)) {
+        kpanicf("%s: IDT slot %u is not for MSIs", __func__, idt_slot);
+    }
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&MSI_LOCK);
+    MSI_TAKEN &= ~((uint64_t)1 << (idt_slot - MSI_VECTOR_BASE));
+    spinlock_release_irqrestore(&MSI_LOCK, interrupts_were_enabled);
+}
+
+void interrupt_register(interrupt_isr_t isr, uint8_t idt_slot) {
+    rcu_assign_pointer(INT_HANDLERS[(size_t)idt_slot], isr);
+}
+
+void interrupt_trace_set(uint8_t idt_slot, bool enabled) {
+    const uint64_t bit = (uint64_t)1 << (idt_slot % 64);
+    if (enabled) {
+        __atomic_fetch_or(&INT_TRACED[idt_slot / 64], bit, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&INT_TRACED[idt_slot / 64], ~bit, __ATOMIC_RELAXED);
+    }
+}
+
+static bool traced(uint8_t idt_slot) {
+    return (__atomic_load_n(&INT_TRACED[idt_slot / 64], __ATOMIC_RELAXED) & ((uint64_t)1 << (idt_slot % 64))) != 0;
+}
+
+void interrupt_resume_frame_set(struct interrupt_isr_data_t* frame) { smp_cpu()->int_resume_frame = frame; }
+
+void interrupt_resume_unlock_set(struct ticketlock_t* lock, struct interrupt_isr_data_t* frame) {
+    struct smp_cpu_t* cpu = smp_cpu();
+    cpu->int_resume_unlock = lock;
+    cpu->int_resume_unlock_frame = frame;
+}
+
+/// Called by ASM right before resuming a frame.
+void interrupt_resume_finish(struct interrupt_isr_data_t* frame) {
+    struct smp_cpu_t* cpu = smp_cpu();
+    // Frames of nested exceptions don't count, the lock is still needed until the outer handler switched stacks
+    if (cpu->int_resume_unlock != NULL && cpu->int_resume_unlock_frame == frame) {
+        struct ticketlock_t* lock = cpu->int_resume_unlock;
+        cpu->int_resume_unlock = NULL;
+        cpu->int_resume_unlock_frame = NULL;
+        ticketlock_release(lock);
+    }
+}
 
 void interrupt_enable(void) { __asm__ volatile("sti"); }
 
 void interrupt_disable(void) { __asm__ volatile("cli"); }
 
+bool interrupt_enabled(void) {
+    uint64_t rflags;
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "pushfq                 \n\t"
+        "pop %0                 \n\t"
+        ".att_syntax prefix     \n\t"
+        : "=r"(rflags));
+    return (rflags & RFLAGS_IF) != 0;
+}
+
 void interrupt_ack(uint8_t idt_slot) {
-    if (pic_idt_is_managed(idt_slot)) {
-        pic_ack(pic_idt_slot_to_irq(idt_slot));
+    if (CONTROLLER->manages(idt_slot)) {
+        CONTROLLER->ack(idt_slot);
+    } else if (msi_is_managed(idt_slot) && lapic_present()) {
+        lapic_eoi();
     } else {
         kpanicf("%s: can't ack because interrupt controller for IDT slot %u is unknown.", __func__, idt_slot);
     }
@@ -143,15 +380,61 @@ void kprintf_interrupt_isr_data_t(const struct interrupt_isr_data_t* data) {
     kprintf("============================\n");
 }
 
-/// Called by ASM to dispatch interrupts to the appropriate C handler registered in `INT_HANDLERS`.
-void isr_dispatch(struct interrupt_isr_data_t* data) {
-    kprintf("%s: taken interrupt, saved data:\n", __func__);
-    kprintf_interrupt_isr_data_t(data);
-    // Do we have a registered C ISR for this?
-    interrupt_isr_t handler = INT_HANDLERS[(size_t)data->int_num];
-    if (handler != NULL) {
+/// Run the handler on the stack it's interrupt is meant to be handled on.
+static void handler_call(interrupt_isr_t handler, struct interrupt_isr_data_t* data, struct smp_cpu_t* cpu) {
+    const uint8_t ist = IDT[data->int_num].ist;
+    cpu->int_depth++;
+    if (ist != IST_NONE) {
+        // The CPU already switched to the IST entry's stack, which nested exceptions of the same vector start below
+        const uintptr_t top = gdt_ist_get(ist);
+        const bool outermost = top == IST_TOPS[cpu->id][ist - 1];
+        if (outermost) {
+            gdt_ist_set(ist, top - IST_NESTED_OFFSET);
+        }
         handler(data);
+        if (outermost) {
+            gdt_ist_set(ist, top);
+        }
+    } else if (cpu->int_depth == 1 && cpu->int_stack_top != 0) {
+        // The frame stays on the interrupted thread's stack, where switching threads expects it,
+        // but everything the handler calls goes on the CPU's own stack instead
+        interrupt_stack_call(handler, data, cpu->int_stack_top);
     } else {
+        // Nested within another handler, which already left the thread's stack
+        handler(data);
+    }
+    cpu->int_depth--;
+}
+
+/// Called by ASM to dispatch interrupts to the appropriate C handler registered in `INT_HANDLERS`.
+///
+/// Return the frame the ASM stub should resume.
+struct interrupt_isr_data_t* isr_dispatch(struct interrupt_isr_data_t* data) {
+    const uint8_t idt_slot = (uint8_t)data->int_num;
+    const bool trace = __builtin_expect(traced(idt_slot), false);
+    if (trace) {
+        kprintf("%s: taken interrupt %u on CPU %lu, saved data:\n", __func__, idt_slot, smp_cpu()->id);
+        kprintf_interrupt_isr_data_t(data);
+    }
+    // Do we have a registered C ISR for this?
+    // Handlers are registered from any CPU at any time, but dispatching is an RCU reader and takes no lock
+    interrupt_isr_t handler = rcu_dereference(INT_HANDLERS[idt_slot]);
+    if (handler == NULL) {
+        kprintf_interrupt_isr_data_t(data);
         kpanicf("%s: got unhandled interrupt number %lu with argument %lu", __func__, data->int_num, data->int_arg);
     }
+
+    // Unless the handler switches threads, resume where we were interrupted
+    struct smp_cpu_t* cpu = smp_cpu();
+    struct interrupt_isr_data_t* const outer_resume_frame = cpu->int_resume_frame;
+    cpu->int_resume_frame = data;
+    handler_call(handler, data, cpu);
+    struct interrupt_isr_data_t* const resume_frame = cpu->int_resume_frame;
+    // Exceptions raised within another handler must not disturb what the outer one resumes
+    cpu->int_resume_frame = outer_resume_frame;
+    if (trace && resume_frame != data) {
+        kprintf("%s: handler of interrupt %u switched frames, resuming data:\n", __func__, idt_slot);
+        kprintf_interrupt_isr_data_t(resume_frame);
+    }
+    return resume_frame;
 }
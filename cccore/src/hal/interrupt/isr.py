@@ -1,12 +1,35 @@
 #!/usr/bin/env python3
 # -*- coding: utf-8 -*-
 
+# Generates the ISR entry stubs, invoked by the Makefile which assembles the output.
+#
+# Every stub is at most 8 bytes long and 8-byte aligned, so that the IDT entry of vector i is simply
+# ISR_STUBS + 8 * i. Each pushes it's vector and jumps to the entry path suited for it, which is where all
+# shared work happens.
+
 num_isr = 256
-pushes_error = [8, 10, 11, 12, 13, 14, 17]
+stub_size = 8
+# Exceptions for which the CPU pushes an error code
+pushes_error = [8, 10, 11, 12, 13, 14, 17, 21, 29, 30]
+# Vectors below this are exceptions, all others are raised by devices or other CPUs, or by software
+num_exceptions = 32
+# Vectors raised by software with arguments in registers
+syscalls = [0x80]
+
+
+def entry_of(i):
+    if i in syscalls:
+        return None
+    if i < num_exceptions:
+        return 'isr_entry_exception_error' if i in pushes_error else 'isr_entry_exception'
+    return 'isr_entry_irq'
+
 
 print('''
 .intel_syntax noprefix
 .extern isr_common
+.extern isr_dispatch
+.extern isr_common_return
 ''')
 
 
@@ -15,26 +38,107 @@ print('''
 Interrupt Service Routines
 This file is autogenerated by the isr.py script, do not edit by hand
 
-Each generated routine pushes a dummy argument if the CPU does not provide one,
-followed by the ISR number.
+Each generated stub pushes the ISR number as a sign-extended byte, which the entry path it jumps to
+turns back into the actual number. Entry paths of interrupts without an error code push a dummy argument
+in it's place.
 */
-''')
 
+.section .text
+.global ISR_STUBS
+.balign {0}
+ISR_STUBS:'''.format(stub_size))
+
+# Placing each stub with .org makes the assembler fail if the previous one exceeds it's size
 for i in range(num_isr):
-    print('''isr{0}:
-    cli
-    {1}
+    entry = entry_of(i)
+    if entry is None:
+        # The syscall path pushes the number itself, which saves it the decoding
+        print('''.org ISR_STUBS + {0}, 0xcc
+isr{1}:
+    jmp isr_entry_syscall{1}'''.format(i * stub_size, i))
+    else:
+        # push imm8, spelled out as the assembler would use imm32 for numbers above 127
+        print('''.org ISR_STUBS + {0}, 0xcc
+isr{1}:
+    .byte 0x6a, {2}
+    jmp {3}'''.format(i * stub_size, i, i & 0xff, entry))
+
+print('''.org ISR_STUBS + {0}, 0xcc
+'''.format(num_isr * stub_size))
+
+print('''
+//; Exceptions pushing an error code, which takes the argument's place.
+isr_entry_exception_error:
+    and qword ptr [rsp], 0xFF
+    jmp isr_common
+
+//; Exceptions without an error code.
+isr_entry_exception:
+    push qword ptr [rsp]
+    mov qword ptr [rsp + 8], 0
+    and qword ptr [rsp], 0xFF
+    jmp isr_common
+''')
+
+for i in syscalls:
+    print('''//; Syscalls take their arguments from and return results in the saved registers, so they're all saved.
+isr_entry_syscall{0}:
+    push 0
     push {0}
-    jmp isr_common'''.format(i,
-        'push 0' if i not in pushes_error else 'nop'))
+    jmp isr_common
+'''.format(i))
 
-print('')
 print('''
-// Vector table
+//; IRQs, whose handlers are C functions which preserve the callee-saved registers themselves.
+//; So only the others are saved, while the slots of callee-saved ones are left as they are.
+//; Only if the handler switches threads, they're filled in for the interrupted thread to be resumed later.
+isr_entry_irq:
+    push qword ptr [rsp]
+    mov qword ptr [rsp + 8], 0
+    and qword ptr [rsp], 0xFF
+    sub rsp, 4*8 //; r15, r14, r13, r12
+    push r11
+    push r10
+    push r9
+    push r8
+    sub rsp, 1*8 //; rbp
+    push rdi
+    push rsi
+    push rdx
+    push rcx
+    sub rsp, 1*8 //; rbx
+    push rax
 
-.section .data
-.global ISR_TABLE
-ISR_TABLE:''')
+    mov rdi, rsp
+    call isr_dispatch
+    cmp rax, rsp
+    jne isr_entry_irq_switch
 
-for i in range(num_isr):
-    print('  .quad isr{}'.format(i))
\ No newline at end of file
+    //; Handlers only have a lock released along with switching threads,
+    //; so there's nothing for interrupt_resume_finish to do when resuming the same frame.
+    pop rax
+    add rsp, 1*8
+    pop rcx
+    pop rdx
+    pop rsi
+    pop rdi
+    add rsp, 1*8
+    pop r8
+    pop r9
+    pop r10
+    pop r11
+    //; Also removes argument and ISR number.
+    add rsp, 4*8 + 2*8
+    iretq
+
+isr_entry_irq_switch:
+    //; Still the interrupted thread's values, which the handler preserved.
+    mov [rsp + 1*8], rbx
+    mov [rsp + 6*8], rbp
+    mov [rsp + 11*8], r12
+    mov [rsp + 12*8], r13
+    mov [rsp + 13*8], r14
+    mov [rsp + 14*8], r15
+    mov rsp, rax
+    jmp isr_common_return
+''')
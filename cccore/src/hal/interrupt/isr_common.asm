@@ -1,6 +1,7 @@
 .intel_syntax noprefix
 
-.extern isr_disptach
+.extern isr_dispatch
+.extern interrupt_resume_finish
 
 //; FIXME: This assumes we were in userspace when interrupt arrived
 
@@ -31,6 +32,23 @@ isr_common:
 	mov rdi, rsp
 	call isr_dispatch
 
+	//; The dispatcher returns the frame to resume.
+	//; This is the one we just pushed, unless a handler switched threads,
+	//; in which case it's the frame the new thread was suspended with, sitting on the new thread's stack.
+	mov rsp, rax
+
+//; Resume the frame rsp points to.
+//; Also jumped to directly in order to enter a thread for the first time.
+.global isr_common_return
+isr_common_return:
+	//; Let C release whatever was held for the switch to this frame, now that the old stack was left.
+	//; The frame isn't necessarily aligned for a call, rbx is restored from the frame below anyways.
+	mov rdi, rsp
+	mov rbx, rsp
+	and rsp, -16
+	call interrupt_resume_finish
+	mov rsp, rbx
+
 	//; Restore all previously saved registers.
 	pop rax
 	pop rbx
@@ -49,6 +67,20 @@ isr_common:
 	pop r15
 
 	//; Remove argument and ISR number before returning.
-	sub rsp, 2*8
-	//; CPU will pop RIP, CS, RFLAGS, and SS and resume execution.
+	add rsp, 2*8
+	//; CPU will pop RIP, CS, RFLAGS, RSP and SS and resume execution.
 	iretq
+
+//; Call the handler in rdi with the frame in rsi as argument, on the stack whose top is in rdx.
+//; Returns to the calling stack afterwards, which the handler never sees.
+.global interrupt_stack_call
+interrupt_stack_call:
+	push rbp
+	mov rbp, rsp
+	mov rsp, rdx
+	mov rax, rdi
+	mov rdi, rsi
+	call rax
+	mov rsp, rbp
+	pop rbp
+	ret
@@ -0,0 +1,116 @@
+#include "include/ipi.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "include/interrupt.h"
+#include "include/smp.h"
+#include "interrupt/controller/lapic.h"
+
+/// Make the calls other CPUs asked of the calling one.
+static void calls_run(void) {
+    struct smp_cpu_t *cpu = smp_cpu();
+    uint64_t pending = __atomic_exchange_n(&cpu->ipi_calls_pending, 0, __ATOMIC_ACQUIRE);
+    while (pending != 0) {
+        const size_t from = (size_t)__builtin_ctzll(pending);
+        pending &= pending - 1;
+        struct ipi_call_t *call = cpu->ipi_calls[from];
+        call->func(call->arg);
+        // The caller may return and drop the call right after
+        __atomic_sub_fetch(&call->remaining, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void call_isr(struct interrupt_isr_data_t *data) {
+    (void)data;
+    lapic_eoi();
+    calls_run();
+}
+
+/// Called for every reschedule IPI.
+static interrupt_isr_t RESCHEDULE_CALLBACK = NULL;
+
+static void reschedule_isr(struct interrupt_isr_data_t *data) {
+    lapic_eoi();
+    if (RESCHEDULE_CALLBACK != NULL) {
+        RESCHEDULE_CALLBACK(data);
+    }
+}
+
+void ipi_init(void) {
+    interrupt_register(call_isr, IPI_VECTOR_CALL);
+    interrupt_register(reschedule_isr, IPI_VECTOR_RESCHEDULE);
+    ipi_init_ap();
+}
+
+void ipi_init_ap(void) {
+    if (lapic_present()) {
+        lapic_enable();
+    }
+}
+
+void ipi_reschedule_enable(interrupt_isr_t callback) { RESCHEDULE_CALLBACK = callback; }
+
+/// CPUs that can take IPIs, which excludes the calling one.
+static ipi_cpu_mask_t online_others(void) {
+    ipi_cpu_mask_t cpus = 0;
+    for (size_t i = 0; i < smp_cpu_count(); i++) {
+        if (__atomic_load_n(&SMP_CPUS[i].online, __ATOMIC_ACQUIRE)) {
+            cpus |= (ipi_cpu_mask_t)1 << i;
+        }
+    }
+    return cpus & ~((ipi_cpu_mask_t)1 << smp_cpu()->id);
+}
+
+void ipi_send(size_t cpu, uint8_t vector) { ipi_send_mask((ipi_cpu_mask_t)1 << cpu, vector); }
+
+void ipi_send_mask(ipi_cpu_mask_t cpus, uint8_t vector) {
+    // Also keeps the calling CPU from changing between skipping it and sending
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    cpus &= ~((ipi_cpu_mask_t)1 << smp_cpu()->id);
+    while (cpus != 0) {
+        const size_t i = (size_t)__builtin_ctzll(cpus);
+        cpus &= cpus - 1;
+        lapic_ipi((uint8_t)SMP_CPUS[i].lapic_id, vector);
+    }
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
+
+void ipi_send_all(uint8_t vector) { ipi_send_mask(online_others(), vector); }
+
+void ipi_call_mask(ipi_cpu_mask_t cpus, ipi_func_t func, void *arg) {
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    cpus &= online_others();
+    struct ipi_call_t call = {.func = func, .arg = arg, .remaining = 0};
+    for (ipi_cpu_mask_t left = cpus; left != 0; left &= left - 1) {
+        call.remaining++;
+    }
+
+    // Every CPU has a slot for calls from each other CPU, which is free again once the previous call returned.
+    // So there's no lock, and CPUs calling each other don't contend for anything but the targets' pending bits.
+    const size_t self = smp_cpu()->id;
+    for (ipi_cpu_mask_t left = cpus; left != 0; left &= left - 1) {
+        struct smp_cpu_t *target = &SMP_CPUS[__builtin_ctzll(left)];
+        target->ipi_calls[self] = &call;
+        __atomic_fetch_or(&target->ipi_calls_pending, (uint64_t)1 << self, __ATOMIC_RELEASE);
+    }
+    ipi_send_mask(cpus, IPI_VECTOR_CALL);
+
+    while (__atomic_load_n(&call.remaining, __ATOMIC_ACQUIRE) != 0) {
+        // The targets may be waiting for calls of their own, with interrupts disabled just like here
+        calls_run();
+        __builtin_ia32_pause();
+    }
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
+
+void ipi_call(size_t cpu, ipi_func_t func, void *arg) { ipi_call_mask((ipi_cpu_mask_t)1 << cpu, func, arg); }
+
+void ipi_call_all(ipi_func_t func, void *arg) { ipi_call_mask(online_others(), func, arg); }
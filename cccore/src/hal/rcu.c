@@ -0,0 +1,50 @@
+#include "include/rcu.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "include/interrupt.h"
+#include "include/smp.h"
+#include "thread/include/thread.h"
+
+/// How long writers sleep between checking whether all CPUs passed through a quiescent state.
+#define RCU_POLL_NS (1000 * 1000)
+
+/// Number of grace periods writers started so far.
+///
+/// Only writers increment it, readers merely copy it into their per-CPU data.
+static uint64_t RCU_GP = 0;
+
+void rcu_quiescent(void) {
+    // Plain loads and stores on x86, so reporting costs the reader nothing but it's own cache line.
+    // Nothing read before may be reordered past the store, and nothing read after may see an older version
+    // than the grace period it reports.
+    struct smp_cpu_t *cpu = smp_cpu();
+    __atomic_store_n(&cpu->rcu_quiescent_gp, __atomic_load_n(&RCU_GP, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+/// Check whether the CPU passed through a quiescent state since the given grace period started.
+static bool cpu_quiescent_since(const struct smp_cpu_t *cpu, uint64_t gp) {
+    return !cpu->online || __atomic_load_n(&cpu->rcu_quiescent_gp, __ATOMIC_ACQUIRE) >= gp;
+}
+
+void rcu_synchronize(void) {
+    // Also orders the update before checking on the readers
+    const uint64_t gp = __atomic_add_fetch(&RCU_GP, 1, __ATOMIC_SEQ_CST);
+
+    // The calling thread isn't reading, so neither is it's CPU
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    rcu_quiescent();
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+
+    // Every CPU switches threads or takes a timer interrupt at least once per time slice
+    for (size_t i = 0; i < smp_cpu_count(); i++) {
+        while (!cpu_quiescent_since(&SMP_CPUS[i], gp)) {
+            thread_sleep_ns(RCU_POLL_NS);
+        }
+    }
+}
@@ -7,7 +7,8 @@
 #include "../include/interrupt.h"
 #include "../include/io_port.h"
 #include "../include/serial.h"
-#include "../interrupt/controller/pic.h"
+#include "../include/spinlock.h"
+#include "thread/include/notification.h"
 
 /* Based on https://wiki.osdev.org/Serial_Ports */
 
@@ -66,6 +67,27 @@ enum line_status_t {
     LINE_STATUS_TXBUF_READY = 0b00100000,
 };
 
+/// Size of the buffer received data waits in until a thread reads it, a power of two.
+#define RX_BUF_SIZE 256
+
+/// Data received by the ISR, but not read yet.
+static uint8_t RX_BUF[RX_BUF_SIZE];
+
+/// Bytes read from `RX_BUF` so far, only written by `serial_com1_read`.
+static uint64_t RX_HEAD = 0;
+
+/// Bytes received into `RX_BUF` so far, only written by the ISR.
+static uint64_t RX_TAIL = 0;
+
+/// Notification signalled when data arrives, if any.
+static struct notification_t *RX_NOTIFICATION = NULL;
+
+/// Bits signalled on `RX_NOTIFICATION`.
+static uint64_t RX_NOTIFICATION_BITS = 0;
+
+/// Protects the receive buffer and notification, as the ISR and readers may run on different CPUs.
+static struct spinlock_t RX_LOCK = SPINLOCK_INIT("serial_rx");
+
 /// Calculates the serial clock divisor for a given baud rate.
 static uint16_t baud_2_divisor(uint32_t baud) { return HW_BAUD_RATE / baud; }
 
@@ -117,7 +139,8 @@ static void serial_read_isr(struct interrupt_isr_data_t* data);
 
 static void config_set_irq(void) {
     // Register an ISR that deals with reading the data
-    interrupt_register(serial_read_isr, pic_irq_to_idt_slot(COM1_IRQ));
+    interrupt_register(serial_read_isr, interrupt_irq_to_idt_slot(COM1_IRQ));
+    interrupt_unmask(interrupt_irq_to_idt_slot(COM1_IRQ));
 
     // Enable interrupt on data arrival
     const uint8_t config = IRQ_CTL_DATA_AVAILABLE;
@@ -148,13 +171,47 @@ static bool can_write(void) {
 
 static void serial_read_isr(struct interrupt_isr_data_t* data) {
     (void)data;
-    // TODO: Do we need to ACK to the serial controller?
-    // ACK interrupt controller
-    // Read as much data as exists
+    // Reading the data register is what acknowledges the controller, the interrupt controller is separate
+    spinlock_acquire(&RX_LOCK);
     while (can_read()) {
-        // TODO: Push to ring buffer
-        kprintf("%c", read());
+        const uint8_t c = read();
+        if (RX_NOTIFICATION == NULL) {
+            // Nobody is going to read it, so echo it instead
+            kprintf("%c", c);
+        } else if (RX_TAIL - RX_HEAD < RX_BUF_SIZE) {
+            RX_BUF[RX_TAIL % RX_BUF_SIZE] = c;
+            RX_TAIL++;
+        }
+        // Data arriving faster than it's read is dropped
+    }
+    struct notification_t* const notification = RX_TAIL != RX_HEAD ? RX_NOTIFICATION : NULL;
+    const uint64_t bits = RX_NOTIFICATION_BITS;
+    spinlock_release(&RX_LOCK);
+    interrupt_ack(interrupt_irq_to_idt_slot(COM1_IRQ));
+
+    // All further work is up to the thread, in constant time here
+    if (notification != NULL) {
+        notification_signal(notification, bits);
+    }
+}
+
+void serial_com1_rx_notify(struct notification_t* n, uint64_t bits) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&RX_LOCK);
+    RX_NOTIFICATION = n;
+    RX_NOTIFICATION_BITS = bits;
+    spinlock_release_irqrestore(&RX_LOCK, interrupts_were_enabled);
+}
+
+size_t serial_com1_read(uint8_t* buf, size_t len) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&RX_LOCK);
+    size_t n = 0;
+    while (n < len && RX_HEAD != RX_TAIL) {
+        buf[n] = RX_BUF[RX_HEAD % RX_BUF_SIZE];
+        RX_HEAD++;
+        n++;
     }
+    spinlock_release_irqrestore(&RX_LOCK, interrupts_were_enabled);
+    return n;
 }
 
 void serial_com1_write(uint8_t data) {
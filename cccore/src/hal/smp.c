@@ -0,0 +1,113 @@
+#include "include/smp.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common.h"
+#include "include/cpu.h"
+#include "include/gdt.h"
+#include "mem.h"
+#include "pmm.h"
+#include "stivale2.h"
+
+/// MSR holding the base address of the GS segment.
+static const uint32_t MSR_GS_BASE = 0xC0000101;
+
+/// Order of the stack each application processor starts out on, until it enters it's idle thread.
+static const uint8_t AP_BOOT_STACK_ORDER = 2;
+
+struct smp_cpu_t SMP_CPUS[SMP_CPUS_MAX];
+
+static size_t SMP_CPUS_NUM = 1;
+
+/// What the bootloader told about each CPU, indexed like `SMP_CPUS`.
+static struct stivale2_smp_info *SMP_INFOS[SMP_CPUS_MAX] = {NULL};
+
+/// Function application processors call once they can run C code.
+static void (*AP_ENTRY)(void) = NULL;
+
+/// Make the given per-CPU data the calling CPU's.
+static void cpu_local_set(struct smp_cpu_t *cpu) { cpu_wrmsr(MSR_GS_BASE, (uint64_t)cpu); }
+
+static void cpu_init(struct smp_cpu_t *cpu, size_t id, uint32_t lapic_id) {
+    cpu->self = cpu;
+    cpu->id = id;
+    cpu->lapic_id = lapic_id;
+    cpu->online = false;
+    cpu->int_resume_frame = NULL;
+    cpu->int_resume_unlock = NULL;
+    cpu->int_resume_unlock_frame = NULL;
+    cpu->int_stack_top = 0;
+    cpu->int_depth = 0;
+    cpu->thread_active_tid = 0;
+    cpu->thread_idle_tid = 0;
+    cpu->tickless_slice_start_ns = 0;
+    cpu->tickless_armed_deadline_ns = 0;
+    cpu->tickless_preempt_pending = false;
+    cpu->vmm_active_space = NULL;
+    for (size_t i = 0; i < SMP_CPUS_MAX; i++) {
+        cpu->ipi_calls[i] = NULL;
+    }
+    cpu->ipi_calls_pending = 0;
+    cpu->rcu_quiescent_gp = 0;
+}
+
+void smp_init(const struct stivale2_struct_tag_smp *smp) {
+    cpu_init(&SMP_CPUS[0], 0, smp != NULL ? smp->bsp_lapic_id : 0);
+    SMP_CPUS[0].online = true;
+    cpu_local_set(&SMP_CPUS[0]);
+    if (smp == NULL) {
+        return;
+    }
+
+    for (uint64_t i = 0; i < smp->cpu_count; i++) {
+        struct stivale2_smp_info *info = (struct stivale2_smp_info *)&smp->smp_info[i];
+        if (info->lapic_id == smp->bsp_lapic_id) {
+            continue;
+        }
+        if (SMP_CPUS_NUM == SMP_CPUS_MAX) {
+            kprintf("%s: Leaving CPUs beyond the first %u parked\n", __func__, SMP_CPUS_MAX);
+            break;
+        }
+        cpu_init(&SMP_CPUS[SMP_CPUS_NUM], SMP_CPUS_NUM, info->lapic_id);
+        SMP_INFOS[SMP_CPUS_NUM] = info;
+        SMP_CPUS_NUM++;
+    }
+}
+
+size_t smp_cpu_count(void) { return SMP_CPUS_NUM; }
+
+/// Where application processors jump to from the bootloader's trampoline, on the stack we gave them.
+///
+/// The bootloader's GDT and page tables are still active.
+static void __attribute__((noreturn, force_align_arg_pointer)) ap_entry(struct stivale2_smp_info *info) {
+    gdt_init_flat();
+    // Loading the GDT clears the segments, so GS is only set up afterwards
+    cpu_local_set((struct smp_cpu_t *)info->extra_argument);
+    AP_ENTRY();
+    kpanicf("%s: Returned from entry function\n", __func__);
+}
+
+void smp_start_aps(void (*entry)(void)) {
+    AP_ENTRY = entry;
+    for (size_t i = 1; i < SMP_CPUS_NUM; i++) {
+        uintptr_t stack_phys;
+        if (pmm_alloc(AP_BOOT_STACK_ORDER, &stack_phys) != 0) {
+            kpanicf("%s: Failed to allocate boot stack for CPU %lu\n", __func__, i);
+        }
+        struct stivale2_smp_info *info = SMP_INFOS[i];
+        info->extra_argument = (uint64_t)&SMP_CPUS[i];
+        info->target_stack = (uint64_t)mem_phys_to_virt(stack_phys) + ((uint64_t)MEM_PAGE_SIZE << AP_BOOT_STACK_ORDER);
+        // The AP spins on this field, so it has to be written last, in one go
+        __atomic_store_n(&info->goto_address, (uint64_t)ap_entry, __ATOMIC_SEQ_CST);
+
+        // One after the other, so that they don't race each other through initialization
+        while (!__atomic_load_n(&SMP_CPUS[i].online, __ATOMIC_ACQUIRE)) {
+            __builtin_ia32_pause();
+        }
+    }
+    kprintf("%s: %lu CPUs online\n", __func__, SMP_CPUS_NUM);
+}
+
+void smp_ap_ready(void) { __atomic_store_n(&smp_cpu()->online, true, __ATOMIC_RELEASE); }
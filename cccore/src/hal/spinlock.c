@@ -0,0 +1,204 @@
+#include "include/spinlock.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common.h"
+#include "include/cpu.h"
+#include "include/interrupt.h"
+
+#if CCCORE_LOCK_STATS
+
+/// Every lock that was acquired so far, most recently first.
+static struct lock_stats_t *LOCK_STATS_ALL = NULL;
+
+static void stats_init(struct lock_stats_t *stats, const char *name) {
+    stats->name = name;
+    stats->acquisitions = 0;
+    stats->contentions = 0;
+    stats->max_hold_ticks = 0;
+    stats->registered = false;
+}
+
+/// Account for an acquisition, with the lock held.
+static void stats_acquired(struct lock_stats_t *stats, bool contended) {
+    if (!stats->registered) {
+        stats->registered = true;
+        stats->next = __atomic_load_n(&LOCK_STATS_ALL, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&LOCK_STATS_ALL, &stats->next, stats, true, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED)) {
+        }
+    }
+    stats->acquisitions++;
+    if (contended) {
+        stats->contentions++;
+    }
+    stats->acquired_ticks = cpu_rdtsc();
+}
+
+/// Account for the lock being released, while it's still held.
+static void stats_released(struct lock_stats_t *stats) {
+    const uint64_t held_ticks = cpu_rdtsc() - stats->acquired_ticks;
+    if (held_ticks > stats->max_hold_ticks) {
+        stats->max_hold_ticks = held_ticks;
+    }
+}
+
+#define STATS_INIT(lock, name) stats_init(&(lock)->stats, (name))
+#define STATS_ACQUIRED(lock, contended) stats_acquired(&(lock)->stats, (contended))
+#define STATS_RELEASED(lock) stats_released(&(lock)->stats)
+
+#else
+
+#define STATS_INIT(lock, name) (void)(name)
+#define STATS_ACQUIRED(lock, contended) (void)(contended)
+#define STATS_RELEASED(lock)
+
+#endif
+
+void spinlock_init(struct spinlock_t *lock, const char *name) {
+    lock->locked = 0;
+    STATS_INIT(lock, name);
+}
+
+void spinlock_acquire(struct spinlock_t *lock) {
+    bool contended = false;
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE) != 0) {
+        contended = true;
+        // Wait until the lock looks free before trying again, which doesn't steal the cache line from the holder
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED) != 0) {
+            __builtin_ia32_pause();
+        }
+    }
+    STATS_ACQUIRED(lock, contended);
+}
+
+void spinlock_release(struct spinlock_t *lock) {
+    STATS_RELEASED(lock);
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+bool spinlock_acquire_irqsave(struct spinlock_t *lock) {
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    spinlock_acquire(lock);
+    return interrupts_were_enabled;
+}
+
+void spinlock_release_irqrestore(struct spinlock_t *lock, bool interrupts_were_enabled) {
+    spinlock_release(lock);
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
+
+void ticketlock_init(struct ticketlock_t *lock, const char *name) {
+    lock->next = 0;
+    lock->serving = 0;
+    STATS_INIT(lock, name);
+}
+
+void ticketlock_acquire(struct ticketlock_t *lock) {
+    const uint32_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    bool contended = false;
+    while (__atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE) != ticket) {
+        contended = true;
+        __builtin_ia32_pause();
+    }
+    STATS_ACQUIRED(lock, contended);
+}
+
+bool ticketlock_try_acquire(struct ticketlock_t *lock) {
+    // Free only while nobody drew a ticket past the one being served, in which case that ticket is ours
+    uint32_t ticket = __atomic_load_n(&lock->serving, __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&lock->next, &ticket, ticket + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    STATS_ACQUIRED(lock, false);
+    return true;
+}
+
+void ticketlock_release(struct ticketlock_t *lock) {
+    STATS_RELEASED(lock);
+    // Only the holder writes it, so there's no need for an atomic increment
+    __atomic_store_n(&lock->serving, lock->serving + 1, __ATOMIC_RELEASE);
+}
+
+bool ticketlock_acquire_irqsave(struct ticketlock_t *lock) {
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    ticketlock_acquire(lock);
+    return interrupts_were_enabled;
+}
+
+void ticketlock_release_irqrestore(struct ticketlock_t *lock, bool interrupts_were_enabled) {
+    ticketlock_release(lock);
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
+
+void mcslock_init(struct mcslock_t *lock, const char *name) {
+    lock->tail = NULL;
+    STATS_INIT(lock, name);
+}
+
+void mcslock_acquire(struct mcslock_t *lock, struct mcslock_node_t *node) {
+    node->next = NULL;
+    node->waiting = 1;
+    struct mcslock_node_t *prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    const bool contended = prev != NULL;
+    if (contended) {
+        // The predecessor hands the lock over by clearing our flag, which nobody else touches meanwhile
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->waiting, __ATOMIC_ACQUIRE) != 0) {
+            __builtin_ia32_pause();
+        }
+    }
+    STATS_ACQUIRED(lock, contended);
+}
+
+void mcslock_release(struct mcslock_t *lock, struct mcslock_node_t *node) {
+    STATS_RELEASED(lock);
+    struct mcslock_node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (next == NULL) {
+        // Nobody queued up behind us, unless someone did so just now
+        struct mcslock_node_t *expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        // They swapped themselves in as the tail already, but haven't linked up yet
+        while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL) {
+            __builtin_ia32_pause();
+        }
+    }
+    __atomic_store_n(&next->waiting, 0, __ATOMIC_RELEASE);
+}
+
+bool mcslock_acquire_irqsave(struct mcslock_t *lock, struct mcslock_node_t *node) {
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    mcslock_acquire(lock, node);
+    return interrupts_were_enabled;
+}
+
+void mcslock_release_irqrestore(struct mcslock_t *lock, struct mcslock_node_t *node, bool interrupts_were_enabled) {
+    mcslock_release(lock, node);
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
+
+void lock_stats_dump(void) {
+#if CCCORE_LOCK_STATS
+    kprintf("%s: acquisitions, contended ones and longest hold in TSC ticks of each lock:\n", __func__);
+    for (const struct lock_stats_t *s = __atomic_load_n(&LOCK_STATS_ALL, __ATOMIC_ACQUIRE); s != NULL; s = s->next) {
+        // Racy snapshot, the lock isn't taken so that dumping doesn't disturb what's measured
+        kprintf("%s: %s: %lu, %lu contended, %lu max\n", __func__, s->name != NULL ? s->name : "(unnamed)",
+                s->acquisitions, s->contentions, s->max_hold_ticks);
+    }
+#else
+    kprintf("%s: Lock statistics are not recorded, build with LOCK_STATS=1\n", __func__);
+#endif
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+//! Interface between the generic timer layer and the hardware backing it.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "include/timer.h"
+
+/// A monotonic time source.
+struct clock_source_t {
+    const char* name;
+    /// Nanoseconds since the clock source was set up.
+    uint64_t (*now_ns)(void);
+};
+
+/// A device that interrupts once after a programmable delay.
+struct clock_event_t {
+    const char* name;
+    /// Route the device's expiry to the callback.
+    void (*enable)(timer_callback_t callback);
+    /// Fire once after the delay, replacing any pending expiry.
+    /// Delays beyond what the hardware supports may fire early.
+    void (*arm)(uint64_t delay_ns);
+};
+
+/// Fixed-point factor for converting between units without division or overflow on the hot path.
+struct clock_scale_t {
+    uint64_t mult;
+    uint32_t shift;
+};
+
+/// Compute the scale that converts a value counted at `from_hz` into one counted at `to_hz`.
+struct clock_scale_t clock_scale_compute(uint64_t from_hz, uint64_t to_hz);
+
+/// Convert a value using a scale computed by `clock_scale_compute`.
+uint64_t clock_scale_apply(uint64_t value, struct clock_scale_t scale);
+
+// Backends, which live in their own files.
+
+extern const struct clock_source_t PIT_CLOCK_SOURCE;
+extern const struct clock_event_t PIT_CLOCK_EVENT;
+
+extern const struct clock_source_t TSC_CLOCK_SOURCE;
+
+extern const struct clock_event_t LAPIC_CLOCK_EVENT;
+extern const struct clock_event_t LAPIC_TSC_DEADLINE_CLOCK_EVENT;
@@ -0,0 +1,118 @@
+#include "lapic_timer.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../interrupt/controller/lapic.h"
+#include "clock.h"
+#include "include/cpu.h"
+#include "include/interrupt.h"
+#include "tsc.h"
+
+/// Vector the timer interrupts on.
+static const uint8_t LAPIC_TIMER_VECTOR = 0x30;
+
+/// CPUID leaf 1 ECX flag signaling support for TSC-deadline mode.
+static const uint32_t CPUID_1_ECX_TSC_DEADLINE = 1 << 24;
+
+/// MSR holding the TSC value at which the timer fires in TSC-deadline mode.
+static const uint32_t MSR_TSC_DEADLINE = 0x6E0;
+
+/// Timer modes and flags in the LVT timer register.
+static const uint32_t LVT_TIMER_ONESHOT = 0b00 << 17;
+static const uint32_t LVT_TIMER_TSC_DEADLINE = 0b10 << 17;
+static const uint32_t LVT_TIMER_MASKED = 1 << 16;
+
+/// Divide configuration for dividing the timer's input clock by 16.
+static const uint32_t TIMER_DIVIDE_16 = 0b0011;
+
+static const uint64_t NS_PER_S = 1000000000;
+
+/// Longest delay the timer is armed for in TSC-deadline mode, the caller re-arms after an early expiry.
+///
+/// Keeps the conversion to TSC ticks from overflowing, even for TSCs running at many GHz.
+static const uint64_t TSC_DEADLINE_DELAY_MAX_NS = 3600 * NS_PER_S;
+
+static timer_callback_t LAPIC_TIMER_CALLBACK = NULL;
+
+/// Scale converting nanoseconds to timer ticks.
+static struct clock_scale_t NS_TO_LAPIC_TIMER;
+
+bool lapic_timer_present(void) { return lapic_present(); }
+
+bool lapic_timer_tsc_deadline_present(void) { return (cpu_cpuid(1, 0).ecx & CPUID_1_ECX_TSC_DEADLINE) != 0; }
+
+void lapic_timer_calibration_start(void) {
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LVT_TIMER_ONESHOT | LVT_TIMER_MASKED | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INITIAL_COUNT, UINT32_MAX);
+}
+
+void lapic_timer_calibrate(uint64_t elapsed_ns) {
+    const uint64_t ticks = UINT32_MAX - lapic_read(LAPIC_REG_TIMER_CURRENT_COUNT);
+    lapic_write(LAPIC_REG_TIMER_INITIAL_COUNT, 0);
+
+    const uint64_t timer_hz = (ticks * NS_PER_S) / elapsed_ns;
+    NS_TO_LAPIC_TIMER = clock_scale_compute(NS_PER_S, timer_hz);
+}
+
+static void lapic_timer_isr(struct interrupt_isr_data_t* data) {
+    lapic_eoi();
+    LAPIC_TIMER_CALLBACK(data);
+}
+
+static void lapic_timer_enable(timer_callback_t callback) {
+    LAPIC_TIMER_CALLBACK = callback;
+    interrupt_register(lapic_timer_isr, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LVT_TIMER_ONESHOT | LAPIC_TIMER_VECTOR);
+}
+
+static void lapic_timer_arm(uint64_t delay_ns) {
+    // Clamped to what fits into the 32-bit count register, the caller re-arms after an early expiry
+    uint64_t ticks = clock_scale_apply(delay_ns, NS_TO_LAPIC_TIMER);
+    if (ticks > UINT32_MAX) {
+        ticks = UINT32_MAX;
+    }
+    // Zero would stop the timer instead
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    lapic_write(LAPIC_REG_TIMER_INITIAL_COUNT, (uint32_t)ticks);
+}
+
+static void lapic_timer_tsc_deadline_enable(timer_callback_t callback) {
+    LAPIC_TIMER_CALLBACK = callback;
+    interrupt_register(lapic_timer_isr, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_LVT_TIMER, LVT_TIMER_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+    // The MMIO write to the LVT must complete before the deadline MSR is written
+    __asm__ volatile("mfence" ::: "memory");
+}
+
+static void lapic_timer_tsc_deadline_arm(uint64_t delay_ns) {
+    if (delay_ns > TSC_DEADLINE_DELAY_MAX_NS) {
+        delay_ns = TSC_DEADLINE_DELAY_MAX_NS;
+    }
+    // A deadline of zero would disarm the timer instead
+    uint64_t ticks = tsc_ns_to_ticks(delay_ns);
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    // A deadline that wrapped around would lie in the past, and fire right away
+    const uint64_t now_ticks = cpu_rdtsc();
+    const uint64_t deadline_ticks = now_ticks + ticks < now_ticks ? UINT64_MAX : now_ticks + ticks;
+    cpu_wrmsr(MSR_TSC_DEADLINE, deadline_ticks);
+}
+
+const struct clock_event_t LAPIC_CLOCK_EVENT = {
+    .name = "LAPIC timer",
+    .enable = lapic_timer_enable,
+    .arm = lapic_timer_arm,
+};
+
+const struct clock_event_t LAPIC_TSC_DEADLINE_CLOCK_EVENT = {
+    .name = "LAPIC timer (TSC-deadline)",
+    .enable = lapic_timer_tsc_deadline_enable,
+    .arm = lapic_timer_tsc_deadline_arm,
+};
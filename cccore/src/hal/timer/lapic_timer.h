@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Check whether the CPU has a local APIC timer.
+bool lapic_timer_present(void);
+
+/// Check whether the local APIC timer supports expiring at a given TSC value.
+bool lapic_timer_tsc_deadline_present(void);
+
+/// Let the local APIC timer count down freely, so that it's rate can be measured.
+///
+/// The local APIC must be enabled.
+void lapic_timer_calibration_start(void);
+
+/// Set the local APIC timer's rate based on how far it counted down since `lapic_timer_calibration_start`.
+void lapic_timer_calibrate(uint64_t elapsed_ns);
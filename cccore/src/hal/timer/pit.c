@@ -0,0 +1,217 @@
+#include "pit.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common.h"
+#include "clock.h"
+#include "include/interrupt.h"
+#include "include/io_port.h"
+#include "include/spinlock.h"
+
+static const uint8_t PIT_IRQ = 0;
+static const uint32_t PIT_RATE_HZ = 1193182;
+
+static const uint16_t PIT_PORT_CHANNEL_0 = 0x40;
+static const uint16_t PIT_PORT_CHANNEL_2 = 0x42;
+static const uint16_t PIT_PORT_COMMAND = 0x43;
+
+static const uint8_t PIT_CHANNEL_0 = 0b00000000;
+static const uint8_t PIT_CHANNEL_2 = 0b10000000;
+static const uint8_t PIT_ACCESS_LOHI = 0b00110000;
+static const uint8_t PIT_MODE_0_ONESHOT = 0b00000000;
+static const uint8_t PIT_MODE_2_RATE = 0b00000100;
+static const uint8_t PIT_BINARY = 0b00000000;
+
+/// Read-back command latching both count and status of channel 0.
+static const uint8_t PIT_READ_BACK_CHANNEL_0 = 0b11000010;
+/// Status bit reflecting the channel's output pin, which goes high once a one-shot countdown reaches zero.
+static const uint8_t PIT_STATUS_OUT = 0b10000000;
+
+/// Port controlling the gate of channel 2, which is otherwise wired to the PC speaker.
+static const uint16_t PIT_PORT_CHANNEL_2_GATE = 0x61;
+static const uint8_t PIT_CHANNEL_2_GATE = 0b00000001;
+static const uint8_t PIT_CHANNEL_2_SPEAKER = 0b00000010;
+static const uint8_t PIT_CHANNEL_2_OUT = 0b00100000;
+
+static const uint64_t NS_PER_S = 1000000000;
+
+timer_callback_t PIT_CALLBACK = NULL;
+
+/// Whether the PIT counts down once per `timer_oneshot_arm` instead of periodically.
+static bool PIT_ONESHOT = false;
+
+/// Value the PIT is currently counting down from.
+static uint16_t PIT_RELOAD = 0;
+
+/// Whether the one-shot countdown has reached zero and been accounted for in `PIT_CYCLES_BASE`.
+static bool PIT_ONESHOT_EXPIRED = true;
+
+/// PIT input clock cycles that elapsed before the current countdown started.
+static uint64_t PIT_CYCLES_BASE = 0;
+
+/// Last value returned by `pit_now_ns`, to keep it monotonic despite races with a pending IRQ.
+static uint64_t PIT_LAST_NOW_NS = 0;
+
+/// Protects the PIT's registers and the state above, as any CPU may read the clock or arm the timer.
+static struct spinlock_t PIT_LOCK = SPINLOCK_INIT("pit");
+
+/// Convert PIT input clock cycles to nanoseconds without overflowing for large cycle counts.
+static uint64_t pit_cycles_to_ns(uint64_t cycles) {
+    return ((cycles / PIT_RATE_HZ) * NS_PER_S) + (((cycles % PIT_RATE_HZ) * NS_PER_S) / PIT_RATE_HZ);
+}
+
+/// Convert a duration to PIT input clock cycles, clamped to what fits into a reload register.
+static uint16_t pit_ns_to_reload(uint64_t duration_ns) {
+    uint16_t reload_value = UINT16_MAX;
+    if (duration_ns < pit_cycles_to_ns(UINT16_MAX)) {
+        reload_value = (uint16_t)((duration_ns * PIT_RATE_HZ) / NS_PER_S);
+    }
+    if (reload_value == 0) {
+        reload_value = 1;
+    }
+    return reload_value;
+}
+
+/// Program channel 0 with the given mode and reload value.
+static void pit_program(uint8_t mode, uint16_t reload_value) {
+    const uint8_t settings = PIT_CHANNEL_0 | PIT_ACCESS_LOHI | mode | PIT_BINARY;
+    port_write_u8(PIT_PORT_COMMAND, settings);
+
+    const uint8_t lo_byte = (uint8_t)(reload_value & 0x00FF);
+    port_write_u8(PIT_PORT_CHANNEL_0, lo_byte);
+    const uint8_t hi_byte = (uint8_t)((reload_value & 0xFF00) >> 8);
+    port_write_u8(PIT_PORT_CHANNEL_0, hi_byte);
+
+    PIT_RELOAD = reload_value;
+}
+
+/// Number of cycles that elapsed since the current countdown started, which `PIT_CYCLES_BASE` doesn't include yet.
+///
+/// `PIT_LOCK` must be held.
+static uint64_t pit_countdown_elapsed(void) {
+    if (PIT_ONESHOT && PIT_ONESHOT_EXPIRED) {
+        return 0;
+    }
+
+    port_write_u8(PIT_PORT_COMMAND, PIT_READ_BACK_CHANNEL_0);
+    const uint8_t status = port_read_u8(PIT_PORT_CHANNEL_0);
+    const uint8_t lo_byte = port_read_u8(PIT_PORT_CHANNEL_0);
+    const uint8_t hi_byte = port_read_u8(PIT_PORT_CHANNEL_0);
+    const uint16_t count = (uint16_t)((hi_byte << 8) | lo_byte);
+
+    if (PIT_ONESHOT && (status & PIT_STATUS_OUT) != 0) {
+        // Countdown reached zero, but the IRQ wasn't handled yet. The counter wraps around and keeps going.
+        return PIT_RELOAD + (UINT16_MAX - count) + 1;
+    }
+    return PIT_RELOAD - count;
+}
+
+/// Called by the ASM stub and performs the parts of IRQ handling that can be done in C.
+void pit_isr(struct interrupt_isr_data_t *data) {
+    spinlock_acquire(&PIT_LOCK);
+    if (PIT_ONESHOT) {
+        if (!PIT_ONESHOT_EXPIRED) {
+            PIT_CYCLES_BASE += PIT_RELOAD;
+            PIT_ONESHOT_EXPIRED = true;
+        }
+    } else {
+        PIT_CYCLES_BASE += PIT_RELOAD;
+    }
+    spinlock_release(&PIT_LOCK);
+
+    interrupt_ack(interrupt_irq_to_idt_slot(PIT_IRQ));
+    PIT_CALLBACK(data);
+}
+
+void pit_enable_periodic(uint32_t tickrate_hz, timer_callback_t callback) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&PIT_LOCK);
+    // Convert frequency to timer reload value
+    const uint64_t reload_value_unclamped = PIT_RATE_HZ / tickrate_hz;
+    uint16_t reload_value = (uint16_t)reload_value_unclamped;
+    // If value overflows, clamp to max
+    if (reload_value_unclamped > UINT16_MAX) {
+        reload_value = UINT16_MAX;
+    }
+
+    PIT_ONESHOT = false;
+    pit_program(PIT_MODE_2_RATE, reload_value);
+
+    PIT_CALLBACK = callback;
+    interrupt_register(pit_isr, interrupt_irq_to_idt_slot(PIT_IRQ));
+    interrupt_unmask(interrupt_irq_to_idt_slot(PIT_IRQ));
+    spinlock_release_irqrestore(&PIT_LOCK, interrupts_were_enabled);
+}
+
+void pit_disable(void) { interrupt_mask(interrupt_irq_to_idt_slot(PIT_IRQ)); }
+
+static void pit_oneshot_enable(timer_callback_t callback) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&PIT_LOCK);
+    PIT_ONESHOT = true;
+    PIT_ONESHOT_EXPIRED = true;
+    PIT_CALLBACK = callback;
+    interrupt_register(pit_isr, interrupt_irq_to_idt_slot(PIT_IRQ));
+    interrupt_unmask(interrupt_irq_to_idt_slot(PIT_IRQ));
+    spinlock_release_irqrestore(&PIT_LOCK, interrupts_were_enabled);
+}
+
+static void pit_oneshot_arm(uint64_t delay_ns) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&PIT_LOCK);
+
+    // Account for the part of the countdown that's about to be replaced.
+    // The few cycles spent reprogramming are lost, which is fine for scheduling purposes.
+    PIT_CYCLES_BASE += pit_countdown_elapsed();
+
+    // Clamped to what fits into the 16-bit reload register, the caller re-arms after an early expiry
+    pit_program(PIT_MODE_0_ONESHOT, pit_ns_to_reload(delay_ns));
+    PIT_ONESHOT_EXPIRED = false;
+
+    spinlock_release_irqrestore(&PIT_LOCK, interrupts_were_enabled);
+}
+
+/// Time as counted by the PIT.
+///
+/// The clock only advances while the PIT is counting down, so it must be used together with the PIT's clock events,
+/// which need to be re-armed continuously.
+static uint64_t pit_now_ns(void) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&PIT_LOCK);
+
+    uint64_t now_ns = pit_cycles_to_ns(PIT_CYCLES_BASE + pit_countdown_elapsed());
+    if (now_ns < PIT_LAST_NOW_NS) {
+        now_ns = PIT_LAST_NOW_NS;
+    }
+    PIT_LAST_NOW_NS = now_ns;
+
+    spinlock_release_irqrestore(&PIT_LOCK, interrupts_were_enabled);
+    return now_ns;
+}
+
+uint64_t pit_calibration_wait(uint64_t duration_ns) {
+    const uint16_t reload_value = pit_ns_to_reload(duration_ns);
+
+    // Open the gate, but keep the speaker quiet
+    const uint8_t gate = port_read_u8(PIT_PORT_CHANNEL_2_GATE);
+    port_write_u8(PIT_PORT_CHANNEL_2_GATE, (gate & ~PIT_CHANNEL_2_SPEAKER) | PIT_CHANNEL_2_GATE);
+
+    // Output goes low when programmed, and high once the countdown reaches zero
+    const uint8_t settings = PIT_CHANNEL_2 | PIT_ACCESS_LOHI | PIT_MODE_0_ONESHOT | PIT_BINARY;
+    port_write_u8(PIT_PORT_COMMAND, settings);
+    port_write_u8(PIT_PORT_CHANNEL_2, (uint8_t)(reload_value & 0x00FF));
+    port_write_u8(PIT_PORT_CHANNEL_2, (uint8_t)((reload_value & 0xFF00) >> 8));
+    while ((port_read_u8(PIT_PORT_CHANNEL_2_GATE) & PIT_CHANNEL_2_OUT) == 0) {
+    }
+
+    return pit_cycles_to_ns(reload_value);
+}
+
+const struct clock_source_t PIT_CLOCK_SOURCE = {
+    .name = "PIT",
+    .now_ns = pit_now_ns,
+};
+
+const struct clock_event_t PIT_CLOCK_EVENT = {
+    .name = "PIT",
+    .enable = pit_oneshot_enable,
+    .arm = pit_oneshot_arm,
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "include/timer.h"
+
+/// Programs the PIT to call the callback periodically, at the closest rate to the desired one it supports.
+void pit_enable_periodic(uint32_t tickrate_hz, timer_callback_t callback);
+
+/// Keep the PIT from raising interrupts, for when another device provides the clock events.
+void pit_disable(void);
+
+/// Busy-wait for roughly the given duration using channel 2, which doesn't raise interrupts.
+///
+/// Used for calibrating other clocks. Durations beyond ~54 ms are clamped.
+///
+/// Return the exact duration that was waited, in nanoseconds.
+uint64_t pit_calibration_wait(uint64_t duration_ns);
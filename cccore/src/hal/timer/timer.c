@@ -1,60 +1,109 @@
 #include "include/timer.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 #include "../common.h"
-#include "../interrupt/controller/pic.h"
+#include "../interrupt/controller/lapic.h"
+#include "clock.h"
+#include "include/cpu.h"
 #include "include/interrupt.h"
-#include "include/io_port.h"
+#include "include/smp.h"
+#include "include/spinlock.h"
+#include "lapic_timer.h"
+#include "pit.h"
+#include "tsc.h"
 
-static const uint8_t PIT_IRQ = 0;
-static const uint32_t PIT_RATE_HZ = 1193182;
+/// How long other clocks are measured against the PIT.
+static const uint64_t CALIBRATION_NS = 10 * 1000 * 1000;
 
-static const uint16_t PIT_PORT_CHANNEL_0 = 0x40;
-static const uint16_t PIT_PORT_COMMAND = 0x43;
+/// Source backing `timer_now_ns`.
+static const struct clock_source_t* CLOCK_SOURCE = &PIT_CLOCK_SOURCE;
 
-static const uint8_t PIT_CHANNEL_0 = 0b00000000;
-static const uint8_t PIT_ACCESS_LOHI = 0b00110000;
-static const uint8_t PIT_MODE_2_RATE = 0b00000100;
-static const uint8_t PIT_BINARY = 0b00000000;
+/// Device backing the one-shot timer.
+static const struct clock_event_t* CLOCK_EVENT = &PIT_CLOCK_EVENT;
 
-timer_callback_t PIT_CALLBACK = NULL;
+/// Function called on expiry of the one-shot timer.
+static timer_callback_t ONESHOT_CALLBACK = NULL;
 
-/// Called by the ASM stub and performs the parts of IRQ handling that can be done in C.
-void pit_isr(struct interrupt_isr_data_t *data) {
-    (void)data;
+/// Held while choosing the clocks, which also keeps interrupts from disturbing calibration.
+static struct spinlock_t TIMER_LOCK = SPINLOCK_INIT("timer");
 
-    interrupt_ack(pic_irq_to_idt_slot(PIT_IRQ));
-    PIT_CALLBACK(data);
+struct clock_scale_t clock_scale_compute(uint64_t from_hz, uint64_t to_hz) {
+    // Use as much precision as possible, while keeping the division within 64 bits,
+    // as there's no runtime library providing 128-bit division
+    uint32_t shift = 32;
+    while (shift > 0 && (to_hz >> (64 - shift)) != 0) {
+        shift--;
+    }
+    const struct clock_scale_t scale = {
+        .mult = (to_hz << shift) / from_hz,
+        .shift = shift,
+    };
+    return scale;
 }
 
-/// Programs the legacy PIT timer.
-/// Timer causes IRQ 0 interrupts.
-static void pit_enable(uint32_t tickrate_hz, timer_callback_t callback) {
-    interrupt_disable();  // TODO: Not sufficient w/ multiprocessor
-    // Convert frequency to timer reload value
-    const uint64_t reload_value_unclamped = PIT_RATE_HZ / tickrate_hz;
-    uint16_t reload_value = (uint16_t)reload_value_unclamped;
-    // If value overflows, clamp to max
-    if (reload_value_unclamped > UINT16_MAX) {
-        reload_value = UINT16_MAX;
-    }
+uint64_t clock_scale_apply(uint64_t value, struct clock_scale_t scale) {
+    return (uint64_t)(((unsigned __int128)value * scale.mult) >> scale.shift);
+}
+
+void timer_enable(uint32_t tickrate_hz, timer_callback_t callback) { pit_enable_periodic(tickrate_hz, callback); }
 
-    const uint8_t settings = PIT_CHANNEL_0 | PIT_ACCESS_LOHI | PIT_MODE_2_RATE | PIT_BINARY;
-    port_write_u8(PIT_PORT_COMMAND, settings);
+void timer_oneshot_enable(timer_callback_t callback) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&TIMER_LOCK);
 
-    const uint8_t lo_byte = (uint8_t)(reload_value & 0x00FF);
-    port_write_u8(PIT_PORT_CHANNEL_0, lo_byte);
-    const uint8_t hi_byte = (uint8_t)((reload_value & 0xFF00) >> 8);
-    port_write_u8(PIT_PORT_CHANNEL_0, hi_byte);
+    // Without a TSC, there's nothing to calibrate other clocks against, so the PIT does everything
+    if (tsc_present()) {
+        if (!tsc_invariant()) {
+            kprintf("WARNING: TSC is not invariant, time may drift under power management\n");
+        }
+
+        const bool lapic_timer = lapic_timer_present();
+        if (lapic_timer) {
+            lapic_enable();
+            lapic_timer_calibration_start();
+        }
+        const uint64_t start_ticks = cpu_rdtsc();
+        const uint64_t elapsed_ns = pit_calibration_wait(CALIBRATION_NS);
+        const uint64_t end_ticks = cpu_rdtsc();
+        if (lapic_timer) {
+            lapic_timer_calibrate(elapsed_ns);
+        }
+        tsc_calibrate(start_ticks, end_ticks, elapsed_ns);
+
+        CLOCK_SOURCE = &TSC_CLOCK_SOURCE;
+        if (lapic_timer && lapic_timer_tsc_deadline_present()) {
+            CLOCK_EVENT = &LAPIC_TSC_DEADLINE_CLOCK_EVENT;
+        } else if (lapic_timer) {
+            CLOCK_EVENT = &LAPIC_CLOCK_EVENT;
+        }
+    }
 
-    PIT_CALLBACK = callback;
-    // TODO: Build better abstraction to decouple from PIC
-    interrupt_register(pit_isr, pic_irq_to_idt_slot(PIT_IRQ));
+    if (CLOCK_EVENT != &PIT_CLOCK_EVENT) {
+        pit_disable();
+    }
+    kprintf("Clock source: %s, clock events: %s\n", CLOCK_SOURCE->name, CLOCK_EVENT->name);
+    ONESHOT_CALLBACK = callback;
+    CLOCK_EVENT->enable(callback);
+    spinlock_release_irqrestore(&TIMER_LOCK, interrupts_were_enabled);
+}
+
+void timer_oneshot_enable_ap(void) {
+    // Only the local APIC's timer exists once per CPU, the PIT keeps interrupting the BSP alone
+    if (CLOCK_EVENT == &PIT_CLOCK_EVENT) {
+        return;
+    }
+    lapic_enable();
+    CLOCK_EVENT->enable(ONESHOT_CALLBACK);
 }
 
-void timer_enable(uint32_t tickrate_hz, timer_callback_t callback) {
-    // For now, only PIT is supported
-    pit_enable(tickrate_hz, callback);
+void timer_oneshot_arm(uint64_t delay_ns) {
+    // The PIT only interrupts the BSP, so application processors must not rearm it for deadlines of their own
+    if (CLOCK_EVENT == &PIT_CLOCK_EVENT && smp_cpu()->id != 0) {
+        return;
+    }
+    CLOCK_EVENT->arm(delay_ns);
 }
+
+uint64_t timer_now_ns(void) { return CLOCK_SOURCE->now_ns(); }
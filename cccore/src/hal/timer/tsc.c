@@ -0,0 +1,54 @@
+#include "tsc.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "include/cpu.h"
+
+/// CPUID leaf 1 EDX flag signaling presence of a TSC.
+static const uint32_t CPUID_1_EDX_TSC = 1 << 4;
+
+/// CPUID leaf reporting the highest supported extended leaf.
+static const uint32_t CPUID_EXT_MAX = 0x80000000;
+/// CPUID extended leaf reporting power management features.
+static const uint32_t CPUID_EXT_POWER = 0x80000007;
+/// Power management EDX flag signaling an invariant TSC.
+static const uint32_t CPUID_EXT_POWER_EDX_INVARIANT_TSC = 1 << 8;
+
+static const uint64_t NS_PER_S = 1000000000;
+
+/// TSC value at which the clock source's time starts.
+static uint64_t TSC_START = 0;
+
+/// Scale converting TSC ticks to nanoseconds.
+static struct clock_scale_t TSC_TO_NS;
+
+/// Scale converting nanoseconds to TSC ticks.
+static struct clock_scale_t NS_TO_TSC;
+
+bool tsc_present(void) { return (cpu_cpuid(1, 0).edx & CPUID_1_EDX_TSC) != 0; }
+
+bool tsc_invariant(void) {
+    if (cpu_cpuid(CPUID_EXT_MAX, 0).eax < CPUID_EXT_POWER) {
+        return false;
+    }
+    return (cpu_cpuid(CPUID_EXT_POWER, 0).edx & CPUID_EXT_POWER_EDX_INVARIANT_TSC) != 0;
+}
+
+void tsc_calibrate(uint64_t start_ticks, uint64_t end_ticks, uint64_t elapsed_ns) {
+    const uint64_t tsc_hz = ((end_ticks - start_ticks) * NS_PER_S) / elapsed_ns;
+    TSC_TO_NS = clock_scale_compute(tsc_hz, NS_PER_S);
+    NS_TO_TSC = clock_scale_compute(NS_PER_S, tsc_hz);
+    TSC_START = start_ticks;
+}
+
+uint64_t tsc_ns_to_ticks(uint64_t duration_ns) { return clock_scale_apply(duration_ns, NS_TO_TSC); }
+
+/// Reading the clock is a single instruction, no I/O involved.
+static uint64_t tsc_now_ns(void) { return clock_scale_apply(cpu_rdtsc() - TSC_START, TSC_TO_NS); }
+
+const struct clock_source_t TSC_CLOCK_SOURCE = {
+    .name = "TSC",
+    .now_ns = tsc_now_ns,
+};
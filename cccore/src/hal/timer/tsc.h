@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Check whether the CPU has a time stamp counter.
+bool tsc_present(void);
+
+/// Check whether the time stamp counter ticks at a constant rate, regardless of power states.
+bool tsc_invariant(void);
+
+/// Set the TSC frequency by telling how many ticks were counted during the given time.
+///
+/// Time as reported by the clock source starts at the calibration's starting point.
+void tsc_calibrate(uint64_t start_ticks, uint64_t end_ticks, uint64_t elapsed_ns);
+
+/// Convert a duration to TSC ticks.
+///
+/// Only valid after calibration.
+uint64_t tsc_ns_to_ticks(uint64_t duration_ns);
@@ -5,9 +5,16 @@
 #include "hal/include/exception.h"
 #include "hal/include/gdt.h"
 #include "hal/include/interrupt.h"
+#include "hal/include/ipi.h"
+#include "hal/include/smp.h"
 #include "hal/include/timer.h"
+#include "mem/include/kmalloc.h"
+#include "mem/include/mem.h"
+#include "mem/include/pmm.h"
+#include "mem/include/vmm.h"
 #include "stivale2.h"
 #include "tcb.h"
+#include "thread/include/ipc.h"
 #include "thread/include/thread.h"
 #include "thread/sched/include/sched.h"
 #include "thread/src/internal.h"
@@ -15,70 +22,67 @@
 #define STACK_SIZE 4096
 static uint8_t stack[STACK_SIZE];
 
+/// Asks the bootloader to start up all CPUs and park the application processors until we give them a stack.
+static struct stivale2_header_tag_smp stivale_hdr_smp = {
+    .tag = {.identifier = STIVALE2_HEADER_TAG_SMP_ID, .next = 0},
+    .flags = 0,  // xAPIC, as the local APIC driver doesn't speak x2APIC
+};
+
 __attribute__((section(".stivale2hdr"), used)) static struct stivale2_header stivale_hdr = {
     .entry_point = 0,                           // Leave ELF default
     .stack = (uintptr_t)stack + sizeof(stack),  // Stack grows downwards
     .flags = (1 << 1) | (1 << 2),               // Higher half w/ MMU configured as in linker script
-    .tags = 0,                                  // No tags means the bootloader will give us CGA text mode or bust
+    .tags = (uintptr_t)&stivale_hdr_smp,        // No framebuffer tag means the bootloader gives us CGA text mode or bust
 };
 
-void kmain(void);
+void kmain(struct stivale2_struct *config);
 
 // NOLINTNEXTLINE (bugprone-reserved-identifier)
 void _start(struct stivale2_struct *config) {
-    (void)config;  // Don't care about stivale data for now
-
     // TODO: Zero out .bss
-    kmain();
+    kmain(config);
     while (true) {
     }
 }
 
-static struct thread_cpu_state_t isr_data_2_cpu_state(const struct interrupt_isr_data_t *const data) {
-    struct thread_cpu_state_t t_cpu;
-    t_cpu.rax = data->rax;
-    t_cpu.rbx = data->rbx;
-    t_cpu.rcx = data->rcx;
-    t_cpu.rdx = data->rdx;
-    t_cpu.r8 = data->r8;
-    t_cpu.r9 = data->r9;
-    t_cpu.r10 = data->r10;
-    t_cpu.r11 = data->r11;
-    t_cpu.r12 = data->r12;
-    t_cpu.r13 = data->r13;
-    t_cpu.r14 = data->r14;
-    t_cpu.r15 = data->r15;
-    t_cpu.rdi = data->rdi;
-    t_cpu.rsi = data->rsi;
-    t_cpu.rbp = data->rbp;
-    t_cpu.rip = data->rip;
-    t_cpu.rsp = data->rsp;
-
-    return t_cpu;
-}
-
+/// Called whenever the timer expires.
+///
+/// Tracing it's IDT slot with `interrupt_trace_set` dumps the registers of the old and the new thread.
 static void timer(struct interrupt_isr_data_t *isr_data) {
-    kprintf("%s: tick\n", __func__);
-    // Convert CPU state to format expected by thread subsystem
-    struct thread_cpu_state_t t_cpu = isr_data_2_cpu_state(isr_data);
-
-    // TODO: Let thread switcher load registers as expected
-    // For now, just letting the old process run again is good enough
-
-    // Let scheduler pick next thread to run
-    const thread_tid_t tid_new = thread_sched_round_robin();
-    const thread_tid_t tid_old = thread_get_current_tid();
-    // TODO: Remove
-    kprintf("%s: state of old thread %lu:\n", __func__, tid_old);
-    thread_dump_state(tid_old);
-    kprintf("%s: state of new thread %lu:\n", __func__, tid_new);
-    thread_dump_state(tid_new);
-    thread_switch_prepare(t_cpu, tid_old, tid_new, isr_data);
-
-    // Return from ISR, causing the interrupt handler to load the registers
+    // Wake sleepers, let scheduler pick next thread to run and arm the timer for the next deadline
+    thread_timer_expired(isr_data);
+
+    // Return from ISR, causing the ASM stub to resume the new thread
     return;
 }
 
+/// Find the tag with the given ID among the ones passed by the bootloader.
+///
+/// Return NULL if the bootloader didn't pass such a tag.
+static void *stivale2_tag_find(struct stivale2_struct *config, uint64_t id) {
+    struct stivale2_tag *tag = (struct stivale2_tag *)config->tags;
+    while (tag != NULL) {
+        if (tag->identifier == id) {
+            return tag;
+        }
+        tag = (struct stivale2_tag *)tag->next;
+    }
+    return NULL;
+}
+
+/// Where each application processor ends up once it's running on the kernel's GDT, with it's per-CPU data set up.
+static void __attribute__((noreturn)) ap_main(void) {
+    interrupt_init_ap();
+    vmm_init_ap();
+    ipi_init_ap();
+    timer_oneshot_enable_ap();
+    kprintf("%s: CPU %lu online\n", __func__, smp_cpu()->id);
+    smp_ap_ready();
+
+    // Like on the BSP, interrupts stay disabled until the CPU's idle thread is entered
+    thread_go();
+}
+
 /*
 void test_thread_1(void) {
     while (true) {
@@ -92,24 +96,51 @@ void test_thread_2(void) {
 }
 */
 
-void kmain(void) {
+void kmain(struct stivale2_struct *config) {
     interrupt_disable();
     kprint_init();
     kprintf("%s: hello\n", __func__);
 
     gdt_init_flat();
+    // Everything from here on may rely on per-CPU data
+    smp_init(stivale2_tag_find(config, STIVALE2_STRUCT_TAG_SMP_ID));
     interrupt_init();
     exception_register_default();
-
-    timer_enable(1, timer);
-    interrupt_enable();
-
+    ipc_init();
+
+    const struct stivale2_struct_vmap *vmap = stivale2_tag_find(config, STIVALE2_STRUCT_TAG_VMAP);
+    mem_direct_map_init(vmap != NULL ? vmap->addr : MEM_DIRECT_MAP_BASE_DEFAULT);
+    kprint_remap();
+    const struct stivale2_struct_tag_memmap *memmap = stivale2_tag_find(config, STIVALE2_STRUCT_TAG_MEMMAP_ID);
+    if (memmap == NULL) {
+        kpanicf("%s: Bootloader did not pass a memory map\n", __func__);
+    }
+    pmm_init(memmap);
+    vmm_init(memmap, stivale2_tag_find(config, STIVALE2_STRUCT_TAG_PMRS_ID));
+    kmalloc_init();
+    // Before anything interrupts threads, and before the application processors load their share
+    interrupt_stacks_init();
+    // Other CPUs have to be reachable before they're started, for invalidating their TLBs
+    ipi_init();
+    interrupt_controller_init(stivale2_tag_find(config, STIVALE2_STRUCT_TAG_RSDP_ID));
+
+    // The thread subsystem arms the timer whenever it has a deadline, instead of it ticking periodically
+    timer_oneshot_enable(timer);
+    // Idle CPUs are woken by the CPU that made a thread ready for them, rather than polling for it
+    ipi_reschedule_enable(thread_reschedule_requested);
+
+    // Interrupts stay disabled until the idle thread is entered, as there's no thread to preempt before then
     thread_threading_init();
+    smp_start_aps(ap_main);
+#if CCCORE_BENCH
+    // One after the other, as the scheduler benchmark keeps every CPU busy
+    ipc_bench_start(thread_sched_bench_start);
+#endif
     /*
     thread_tid_t test_1_tid;
-    thread_create(test_thread_1, &test_1_tid);
+    thread_create(test_thread_1, 0, &test_1_tid);
     thread_tid_t test_2_tid;
-    thread_create(test_thread_2, &test_2_tid);
+    thread_create(test_thread_2, 0, &test_2_tid);
     */
     kprintf("%s: Starting idle thread!\n", __func__);
     thread_go();
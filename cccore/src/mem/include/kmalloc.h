@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+/// Set up the caches backing `kmalloc`.
+///
+/// Only call this once, after `pmm_init`.
+void kmalloc_init(void);
+
+/// Allocate memory for the kernel.
+///
+/// Small sizes are served from per-size-class slab caches,
+/// larger ones directly by the physical memory manager.
+///
+/// Return NULL if no memory is available.
+void *kmalloc(size_t size);
+
+/// Free memory allocated by `kmalloc`.
+///
+/// Freeing NULL does nothing.
+void kfree(void *ptr);
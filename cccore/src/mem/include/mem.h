@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+//! Basic facts about the address space, shared by all memory management code.
+
+/// Size of the smallest page, and therefore of a physical frame.
+#define MEM_PAGE_SIZE 4096
+
+/// End of the lower half of each address space, which is private to it.
+///
+/// Addresses from here up to `MEM_KERNEL_HALF_BASE` are non-canonical.
+#define MEM_LOWER_HALF_END 0x0000800000000000
+
+/// Lowest address of the kernel's half of each address space, which all of them share.
+#define MEM_KERNEL_HALF_BASE 0xffff800000000000
+
+/// Where the bootloader maps all physical memory, unless it tells us otherwise.
+#define MEM_DIRECT_MAP_BASE_DEFAULT 0xffff800000000000
+
+/// Where the kernel image is mapped, relative to where it was loaded in physical memory.
+#define MEM_KERNEL_BASE 0xffffffff80000000
+
+/// Set where all physical memory is mapped.
+///
+/// Only call this once, before any other memory management function.
+void mem_direct_map_init(uintptr_t base);
+
+/// Get a pointer through which the given physical address can be accessed.
+void *mem_phys_to_virt(uintptr_t phys);
+
+/// Get the physical address behind a pointer into either the direct map or the kernel image.
+uintptr_t mem_virt_to_phys(const void *virt);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stivale2.h"
+
+/// Largest order of block the physical memory manager deals in.
+///
+/// A block of order `n` consists of `2^n` contiguous, naturally aligned frames.
+#define PMM_ORDER_MAX 10
+
+/// Hand all usable memory in the bootloader's memory map to the physical memory manager.
+///
+/// Only call this once, after `mem_direct_map_init`.
+void pmm_init(const struct stivale2_struct_tag_memmap *memmap);
+
+/// Allocate a block of `2^order` contiguous frames.
+///
+/// Return `-1` if the order is invalid or there's no free block large enough.
+///
+/// Return `0` on success.
+///
+/// The physical address of the block's first frame is written into the outparam.
+int pmm_alloc(uint8_t order, uintptr_t *phys);
+
+/// Return a block allocated by `pmm_alloc` with the same order.
+///
+/// Panic if the block is not properly aligned for it's order, or already free.
+void pmm_free(uintptr_t phys, uint8_t order);
+
+/// Turn an allocated block into `2^order` individually allocated frames, each with one reference.
+///
+/// Each frame must then be returned on it's own, with `pmm_free` or `pmm_unref`.
+/// This allows sharing frames of a physically contiguous block.
+void pmm_split(uintptr_t phys, uint8_t order);
+
+/// Add a reference to a single allocated frame, for sharing it.
+///
+/// Frames start out with one reference when they're allocated.
+void pmm_ref(uintptr_t phys);
+
+/// Drop a reference to a single allocated frame, freeing it once no references are left.
+void pmm_unref(uintptr_t phys);
+
+/// Number of references to a single frame, `0` if it's not allocated.
+uint16_t pmm_refcount(uintptr_t phys);
+
+/// Number of frames that are currently free.
+size_t pmm_free_frames(void);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "include/spinlock.h"
+
+/// Size of a cache line, which objects are aligned to unless they're smaller.
+#define SLAB_CACHE_LINE_SIZE 64
+
+struct slab_t;
+
+/// A cache of equally-sized objects, carved out of slabs of contiguous frames.
+///
+/// Allocating and freeing objects runs in constant time,
+/// frames are only requested from the physical memory manager when all slabs are full.
+struct slab_cache_t {
+    /// Name for diagnostics.
+    const char *name;
+    /// Distance between objects in a slab, which is the object size rounded up to the alignment.
+    size_t object_stride;
+    /// Offset of the first object from the start of the slab, leaving room for the slab's header.
+    size_t object_offset;
+    /// Number of objects in each slab.
+    size_t objects_per_slab;
+    /// Order of the blocks the slabs are made of.
+    uint8_t slab_order;
+    /// Slabs with both allocated and free objects.
+    struct slab_t *partial;
+    /// A slab without allocated objects, kept around so that alternately allocating and freeing doesn't thrash.
+    struct slab_t *empty;
+    /// Protects the slab lists and their free lists, each cache is locked separately.
+    struct spinlock_t lock;
+};
+
+/// Set up a cache for objects of the given size.
+///
+/// Objects are aligned to a cache line, or to the next power of two above their size if they're smaller.
+void slab_cache_init(struct slab_cache_t *cache, const char *name, size_t object_size);
+
+/// Allocate an object from the cache.
+///
+/// Return NULL if no memory is available.
+void *slab_alloc(struct slab_cache_t *cache);
+
+/// Return an object to the cache it was allocated from.
+void slab_free(struct slab_cache_t *cache, void *object);
+
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stivale2.h"
+
+/// Page may be written to.
+#define VMM_FLAG_WRITABLE ((uint64_t)1 << 1)
+/// Page may be accessed from user mode.
+#define VMM_FLAG_USER ((uint64_t)1 << 2)
+/// Page is accessed uncached, for MMIO.
+#define VMM_FLAG_NO_CACHE ((uint64_t)1 << 4)
+/// Page's TLB entry survives address space switches, for mappings that are the same in all of them.
+#define VMM_FLAG_GLOBAL ((uint64_t)1 << 8)
+/// Page may not be executed.
+#define VMM_FLAG_NO_EXECUTE ((uint64_t)1 << 63)
+
+/// Sizes of pages the MMU supports.
+enum vmm_page_size_t {
+    VMM_PAGE_SIZE_4K,
+    VMM_PAGE_SIZE_2M,
+    VMM_PAGE_SIZE_1G,
+};
+
+/// A set of mappings, which threads run in.
+struct vmm_address_space_t;
+
+/// Build the kernel's own page tables and switch to them.
+///
+/// All physical memory is mapped at the direct map base, using the largest pages possible.
+/// The kernel image is mapped with the permissions in the bootloader's protected memory ranges.
+/// The bootloader's identity map is gone afterwards.
+///
+/// Only call this once, after `pmm_init`.
+void vmm_init(const struct stivale2_struct_tag_memmap *memmap, const struct stivale2_struct_tag_pmrs *pmrs);
+
+/// Switch an application processor from the bootloader's page tables to the kernel's address space.
+///
+/// Call this on each application processor, after `vmm_init` ran on the BSP.
+void vmm_init_ap(void);
+
+/// Check whether the MMU supports the given page size.
+bool vmm_page_size_supported(enum vmm_page_size_t size);
+
+/// Map a page of the given size in the active address space.
+///
+/// Both addresses must be aligned to the page size.
+/// Page tables are allocated from the physical memory manager as needed.
+///
+/// Return `-1` if anything is mapped in that range already, the page size is unsupported,
+/// or page tables could not be allocated.
+///
+/// Return `0` on success.
+int vmm_map_page(uintptr_t virt, uintptr_t phys, enum vmm_page_size_t size, uint64_t flags);
+
+/// Map a 4K page in the active address space, see `vmm_map_page`.
+int vmm_map(uintptr_t virt, uintptr_t phys, uint64_t flags);
+
+/// Map a range of contiguous physical memory in the active address space, using the largest pages that fit.
+///
+/// Addresses and size must be aligned to 4K.
+///
+/// Return `-1` if anything is mapped in that range already, or page tables could not be allocated.
+/// Pages mapped before the failure stay mapped.
+///
+/// Return `0` on success.
+int vmm_map_range(uintptr_t virt, uintptr_t phys, size_t size, uint64_t flags);
+
+/// Unmap the page starting at the given address from the active address space, whatever it's size.
+///
+/// Page tables that become empty are not freed.
+///
+/// Return `-1` if no page starts at that address.
+///
+/// Return `0` on success.
+///
+/// The physical address the page was mapped to is written into the outparam.
+int vmm_unmap(uintptr_t virt, uintptr_t *phys);
+
+/// Called for each frame that was mapped by a page `vmm_unmap_range` unmapped, with the context passed to it.
+typedef void (*vmm_frame_release_t)(uintptr_t phys, void *ctx);
+
+/// Unmap every page that starts within the range from the active address space, whatever it's size.
+///
+/// Pages are unmapped in batches, each of which costs other CPUs a single IPI to invalidate, rather than one per page.
+/// The frames the pages were mapped to are handed to the callback once no CPU can reach them through the mapping
+/// anymore, so that it may free them.
+///
+/// Address and size must be aligned to 4K, holes in the range are skipped.
+void vmm_unmap_range(uintptr_t virt, size_t size, vmm_frame_release_t release, void *ctx);
+
+/// Change the flags of the page containing the given address in the active address space, whatever it's size.
+///
+/// Return `-1` if the address is not mapped.
+///
+/// Return `0` on success.
+int vmm_protect(uintptr_t virt, uint64_t flags);
+
+/// Look up the physical address a virtual address in the active address space is mapped to.
+///
+/// Return `-1` if the address is not mapped.
+///
+/// Return `0` on success.
+int vmm_translate(uintptr_t virt, uintptr_t *phys);
+
+/// Reserve a range of virtual memory in the active address space, without backing it by frames yet.
+///
+/// Pages are backed by zeroed frames with the given flags once they're first written to.
+/// Until then, reading them yields zeros from a single shared frame.
+///
+/// Address and size must be aligned to 4K.
+///
+/// Return `-1` if the range overlaps another reservation, or memory for bookkeeping could not be allocated.
+///
+/// Return `0` on success.
+int vmm_reserve(uintptr_t virt, size_t size, uint64_t flags);
+
+/// Release a reservation made by `vmm_reserve`, unmapping it and freeing all frames that were backing it.
+///
+/// Return `-1` if no reservation starts at the given address.
+///
+/// Return `0` on success.
+int vmm_release(uintptr_t virt);
+
+/// The address space the kernel was set up in.
+struct vmm_address_space_t *vmm_address_space_kernel(void);
+
+/// The address space the CPU currently runs in.
+struct vmm_address_space_t *vmm_address_space_active(void);
+
+/// Switch to another address space.
+void vmm_address_space_activate(struct vmm_address_space_t *space);
+
+/// Create a copy-on-write clone of an address space.
+///
+/// Rather than copying anything, all writable pages in the lower half become read-only and shared between both
+/// address spaces. Whichever writes to such a page first gets a private copy then,
+/// so the cost of cloning is proportional to the pages that are actually written to afterwards.
+/// The kernel's upper half is shared by all address spaces anyways.
+/// Frames mapped in the lower half must have been allocated from the physical memory manager.
+///
+/// Return `-1` if memory for page tables or bookkeeping could not be allocated,
+/// or the lower half contains large pages, which can't be cloned.
+///
+/// Return `0` on success.
+///
+/// The clone is written into the outparam.
+int vmm_address_space_clone(struct vmm_address_space_t *src, struct vmm_address_space_t **clone);
+
+/// Destroy an address space, dropping it's references to all frames mapped in it's lower half.
+///
+/// Must not be called on the kernel's address space, or one that is active on any CPU.
+void vmm_address_space_destroy(struct vmm_address_space_t *space);
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "include/spinlock.h"
+#include "slab.h"
+
+/// Header at the start of each slab.
+///
+/// Blocks `kmalloc` gets directly from the physical memory manager start with one as well,
+/// so that `kfree` can tell them apart from slabs.
+struct slab_t {
+    /// Cache the slab belongs to, NULL if the block is not a slab.
+    struct slab_cache_t *cache;
+    /// Order of the block.
+    uint8_t order;
+    /// Next slab in the cache's partial list, if any.
+    struct slab_t *next;
+    /// Previous slab in the cache's partial list, if any.
+    struct slab_t *prev;
+    /// First free object, which holds a pointer to the next one.
+    void *free;
+    /// Number of allocated objects.
+    size_t used;
+};
+
+/// A range of virtual memory that is backed by frames on demand.
+struct region_t {
+    uintptr_t start;
+    uintptr_t end;
+    uint64_t flags;
+    /// Next region with a higher address, if any.
+    struct region_t *next;
+};
+
+/// A set of mappings, of which only the lower half is private, while the kernel's upper half is shared by all.
+struct vmm_address_space_t {
+    /// Physical address of the top-level page table.
+    uintptr_t pml4;
+    /// Regions in this address space, sorted by address.
+    struct region_t *regions;
+    /// Process-context identifier tagging the TLB entries of the lower half, `0` if they're flushed on every switch.
+    uint16_t pcid;
+    /// CPUs whose TLB may hold entries tagged with `pcid`, with bit `i` standing for `SMP_CPUS[i]`.
+    ///
+    /// A CPU whose bit is cleared flushes those entries the next time it switches to the address space.
+    uint64_t tlb_cpus;
+};
+
+/// Page fault error code flag signaling the page was present, so the fault is a protection violation.
+#define PF_ERR_PRESENT ((uint64_t)1 << 0)
+
+/// Page fault error code flag signaling a write access.
+#define PF_ERR_WRITE ((uint64_t)1 << 1)
+
+/// Makes translations of pages mapped global survive switching address spaces.
+#define CR4_PGE ((uint64_t)1 << 7)
+
+/// Set up demand paging of reserved regions, which needs the kernel's own page tables.
+void region_init(void);
+
+/// Frame of zeros which pages in regions that were only ever read from are mapped to.
+///
+/// Never freed, so it's not reference counted either.
+uintptr_t region_zero_page(void);
+
+/// Copy the list of regions from one address space to another.
+///
+/// Return `-1` if memory for bookkeeping could not be allocated.
+///
+/// Return `0` on success.
+int region_clone(const struct vmm_address_space_t *src, struct vmm_address_space_t *dst);
+
+/// Free the list of regions of an address space, without touching it's mappings.
+void region_destroy_all(struct vmm_address_space_t *space);
+
+struct tlb_batch_t;
+
+/// Protects the page tables and region lists of all address spaces.
+///
+/// Held with interrupts disabled, by the page fault handlers as well.
+extern struct spinlock_t VMM_LOCK;
+
+/// Map a 4K page into the active address space, with `VMM_LOCK` held already.
+int vmm_map_locked(uintptr_t virt, uintptr_t phys, uint64_t flags);
+
+/// Unmap a page from the active address space, with `VMM_LOCK` held already.
+///
+/// The calling CPU's TLB is invalidated right away, those of other CPUs only once the batch is flushed.
+int vmm_unmap_locked(uintptr_t virt, uintptr_t *phys, struct tlb_batch_t *batch);
+
+/// Translate an address of the active address space, with `VMM_LOCK` held already.
+int vmm_translate_locked(uintptr_t virt, uintptr_t *phys);
+
+/// Most pages a TLB batch invalidates one by one, any more and other CPUs flush their whole TLB instead.
+#define TLB_BATCH_PAGES_MAX 32
+
+/// Pages whose translations other CPUs may still have cached, collected while changing mappings,
+/// so that all of them are invalidated with a single IPI to each CPU.
+///
+/// Frames that were mapped there may only be freed once the batch is flushed.
+struct tlb_batch_t {
+    /// Address space whose lower half the pages are in.
+    struct vmm_address_space_t *space;
+    /// CPU that invalidated the pages already, when they were added.
+    size_t cpu;
+    /// Pages to invalidate, only valid up to `TLB_BATCH_PAGES_MAX`.
+    uintptr_t pages[TLB_BATCH_PAGES_MAX];
+    /// Number of pages added so far.
+    size_t pages_num;
+    /// Whether any of the pages is in the kernel's half, which all CPUs may have cached regardless of address space.
+    bool kernel_half;
+    /// Whether any of the pages is in the lower half, which only CPUs that ran in the address space have cached.
+    bool lower_half;
+    /// Whether all of the address space's translations are invalidated, rather than single pages.
+    bool all;
+};
+
+/// Detect and enable process-context identifiers on the calling CPU, if the CPU supports them.
+void tlb_init(void);
+
+/// Take a process-context identifier for a new address space, `0` if all of them are taken.
+///
+/// `VMM_LOCK` must be held.
+uint16_t tlb_pcid_alloc(void);
+
+/// Give back a process-context identifier taken by `tlb_pcid_alloc`.
+///
+/// `VMM_LOCK` must be held.
+void tlb_pcid_free(uint16_t pcid);
+
+/// Value to load into CR3 for the calling CPU to switch to the address space.
+///
+/// Entries the CPU cached the last time it ran in the address space are kept, unless they may be stale.
+/// Interrupts must be disabled, and the address space published as the CPU's active one already.
+uint64_t tlb_cr3(struct vmm_address_space_t *space);
+
+/// Start an empty batch for pages of the given address space, which must be the active one to add pages.
+///
+/// Interrupts must be disabled until the last page is added.
+void tlb_batch_init(struct tlb_batch_t *batch, struct vmm_address_space_t *space);
+
+/// Invalidate a page on the calling CPU, and add it to the batch for the others.
+void tlb_batch_add(struct tlb_batch_t *batch, uintptr_t page);
+
+/// Invalidate the whole lower half of the batch's address space on the calling CPU, if it's active there,
+/// and mark it in the batch for the others.
+void tlb_batch_add_all(struct tlb_batch_t *batch);
+
+/// Invalidate everything in the batch on all other CPUs that may have it cached, and wait until they did.
+///
+/// Must not be called with `VMM_LOCK` held, as the other CPUs may be spinning on it with interrupts disabled.
+void tlb_batch_flush(struct tlb_batch_t *batch);
@@ -0,0 +1,86 @@
+#include "kmalloc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "internal.h"
+#include "mem.h"
+#include "pmm.h"
+#include "slab.h"
+
+/// Smallest size class, as a power of two.
+#define KMALLOC_CLASS_MIN_SHIFT 4
+/// Largest size class, as a power of two.
+#define KMALLOC_CLASS_MAX_SHIFT 10
+#define KMALLOC_CLASSES_NUM (KMALLOC_CLASS_MAX_SHIFT - KMALLOC_CLASS_MIN_SHIFT + 1)
+
+/// Caches for allocations of up to 16, 32, ..., 1024 bytes.
+///
+/// Their slabs are single frames, so `kfree` finds the slab header of an object by rounding down to the frame.
+static struct slab_cache_t KMALLOC_CACHES[KMALLOC_CLASSES_NUM];
+
+static const char *const KMALLOC_CACHE_NAMES[KMALLOC_CLASSES_NUM] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128", "kmalloc-256", "kmalloc-512", "kmalloc-1024",
+};
+
+/// Offset of a large allocation from the start of it's block, past the header.
+static const size_t KMALLOC_LARGE_OFFSET = SLAB_CACHE_LINE_SIZE;
+
+_Static_assert(sizeof(struct slab_t) <= SLAB_CACHE_LINE_SIZE, "Header of large allocations does not fit");
+
+void kmalloc_init(void) {
+    for (size_t i = 0; i < KMALLOC_CLASSES_NUM; i++) {
+        slab_cache_init(&KMALLOC_CACHES[i], KMALLOC_CACHE_NAMES[i], (size_t)1 << (KMALLOC_CLASS_MIN_SHIFT + i));
+        if (KMALLOC_CACHES[i].slab_order != 0) {
+            kpanicf("%s: Slabs of %s span more than a frame\n", __func__, KMALLOC_CACHE_NAMES[i]);
+        }
+    }
+}
+
+/// Allocate a block directly from the physical memory manager.
+static void *kmalloc_large(size_t size) {
+    uint8_t order = 0;
+    while (((size_t)MEM_PAGE_SIZE << order) < size + KMALLOC_LARGE_OFFSET) {
+        if (order == PMM_ORDER_MAX) {
+            return NULL;
+        }
+        order++;
+    }
+    uintptr_t phys;
+    if (pmm_alloc(order, &phys) != 0) {
+        return NULL;
+    }
+    struct slab_t *header = mem_phys_to_virt(phys);
+    header->cache = NULL;
+    header->order = order;
+    return (unsigned char *)header + KMALLOC_LARGE_OFFSET;
+}
+
+void *kmalloc(size_t size) {
+    if (size > ((size_t)1 << KMALLOC_CLASS_MAX_SHIFT)) {
+        return kmalloc_large(size);
+    }
+
+    // Index of the smallest class that fits, computed instead of searched for
+    size_t class = 0;
+    if (size > ((size_t)1 << KMALLOC_CLASS_MIN_SHIFT)) {
+        class = (size_t)(64 - __builtin_clzll(size - 1)) - KMALLOC_CLASS_MIN_SHIFT;
+    }
+    return slab_alloc(&KMALLOC_CACHES[class]);
+}
+
+void kfree(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    // Objects never start at a frame boundary, as there's always a header in front of them
+    struct slab_t *header = (struct slab_t *)((uintptr_t)ptr & ~((uintptr_t)MEM_PAGE_SIZE - 1));
+    if (header->cache == NULL) {
+        pmm_free(mem_virt_to_phys(header), header->order);
+    } else {
+        slab_free(header->cache, ptr);
+    }
+}
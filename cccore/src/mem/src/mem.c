@@ -0,0 +1,17 @@
+#include "mem.h"
+
+#include <stdint.h>
+
+static uintptr_t DIRECT_MAP_BASE = MEM_DIRECT_MAP_BASE_DEFAULT;
+
+void mem_direct_map_init(uintptr_t base) { DIRECT_MAP_BASE = base; }
+
+void *mem_phys_to_virt(uintptr_t phys) { return (void *)(phys + DIRECT_MAP_BASE); }
+
+uintptr_t mem_virt_to_phys(const void *virt) {
+    const uintptr_t addr = (uintptr_t)virt;
+    if (addr >= MEM_KERNEL_BASE) {
+        return addr - MEM_KERNEL_BASE;
+    }
+    return addr - DIRECT_MAP_BASE;
+}
@@ -0,0 +1,300 @@
+#include "pmm.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "include/spinlock.h"
+#include "mem.h"
+#include "stivale2.h"
+
+/// Header stored at the start of each free block, linking it into the free list of it's order.
+struct pmm_block_t {
+    struct pmm_block_t *next;
+    struct pmm_block_t *prev;
+};
+
+/// Free blocks of each order, accessed through the direct map.
+static struct pmm_block_t *FREE_LISTS[PMM_ORDER_MAX + 1] = {NULL};
+
+/// Bit `n` is set iff `FREE_LISTS[n]` is not empty, so finding a large enough block doesn't require checking every order.
+static uint32_t FREE_LISTS_NONEMPTY = 0;
+
+_Static_assert(PMM_ORDER_MAX < 32, "PMM_ORDER_MAX does not fit into FREE_LISTS_NONEMPTY");
+
+/// One bit per block of each order, set iff that exact block is in the free list of that order.
+///
+/// This lets freeing a block find out whether it's buddy is free, and therefore merge with it, in constant time.
+static uint8_t *FREE_BITMAPS[PMM_ORDER_MAX + 1] = {NULL};
+
+/// Number of references to each frame, for frames shared between address spaces.
+///
+/// Only maintained for the first frame of each allocated block, and `0` for free ones.
+static uint16_t *REFCOUNTS = NULL;
+
+/// Number of frames covered by the bitmaps, starting at physical address 0.
+static size_t FRAMES_NUM = 0;
+
+/// Number of frames that are currently free.
+static size_t FREE_FRAMES = 0;
+
+/// Protects the free lists, bitmaps and refcounts against other CPUs.
+///
+/// All CPUs allocate frames, so waiters queue up instead of fighting over the lock.
+static struct mcslock_t PMM_LOCK = MCSLOCK_INIT("pmm");
+
+static size_t bitmap_size(uint8_t order) {
+    // Rounded up to whole words, to keep the bitmaps following it aligned
+    const size_t bits = (FRAMES_NUM >> order) + 1;
+    return ((bits + 63) / 64) * sizeof(uint64_t);
+}
+
+static bool bitmap_get(uint8_t order, size_t pfn) {
+    const size_t idx = pfn >> order;
+    return (FREE_BITMAPS[order][idx / 8] & (1 << (idx % 8))) != 0;
+}
+
+static void bitmap_set(uint8_t order, size_t pfn, bool free) {
+    const size_t idx = pfn >> order;
+    if (free) {
+        FREE_BITMAPS[order][idx / 8] |= (uint8_t)(1 << (idx % 8));
+    } else {
+        FREE_BITMAPS[order][idx / 8] &= (uint8_t) ~(1 << (idx % 8));
+    }
+}
+
+static struct pmm_block_t *block_by_pfn(size_t pfn) {
+    return (struct pmm_block_t *)mem_phys_to_virt(pfn * MEM_PAGE_SIZE);
+}
+
+static size_t pfn_by_block(struct pmm_block_t *block) { return mem_virt_to_phys(block) / MEM_PAGE_SIZE; }
+
+static void free_list_push(uint8_t order, size_t pfn) {
+    struct pmm_block_t *block = block_by_pfn(pfn);
+    block->prev = NULL;
+    block->next = FREE_LISTS[order];
+    if (block->next != NULL) {
+        block->next->prev = block;
+    }
+    FREE_LISTS[order] = block;
+    FREE_LISTS_NONEMPTY |= (1U << order);
+    bitmap_set(order, pfn, true);
+}
+
+static void free_list_remove(uint8_t order, size_t pfn) {
+    struct pmm_block_t *block = block_by_pfn(pfn);
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        FREE_LISTS[order] = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    if (FREE_LISTS[order] == NULL) {
+        FREE_LISTS_NONEMPTY &= ~(1U << order);
+    }
+    bitmap_set(order, pfn, false);
+}
+
+/// Put a block into the free lists, merging it with it's buddy for as long as the buddy is free as well.
+///
+/// Interrupts must be disabled.
+static void free_block(size_t pfn, uint8_t order) {
+    FREE_FRAMES += (size_t)1 << order;
+    while (order < PMM_ORDER_MAX) {
+        const size_t buddy_pfn = pfn ^ ((size_t)1 << order);
+        if (buddy_pfn >= FRAMES_NUM || !bitmap_get(order, buddy_pfn)) {
+            break;
+        }
+        free_list_remove(order, buddy_pfn);
+        // The merged block starts at whichever of the two comes first
+        pfn &= ~((size_t)1 << order);
+        order++;
+    }
+    free_list_push(order, pfn);
+}
+
+/// Free all frames in the range, in blocks as large as their alignment allows.
+static void free_range(size_t pfn_start, size_t pfn_end) {
+    while (pfn_start < pfn_end) {
+        uint8_t order = PMM_ORDER_MAX;
+        if (pfn_start != 0 && __builtin_ctzll(pfn_start) < order) {
+            order = (uint8_t)__builtin_ctzll(pfn_start);
+        }
+        while (pfn_start + ((size_t)1 << order) > pfn_end) {
+            order--;
+        }
+        free_block(pfn_start, order);
+        pfn_start += (size_t)1 << order;
+    }
+}
+
+static uintptr_t align_up(uintptr_t addr) { return (addr + MEM_PAGE_SIZE - 1) & ~((uintptr_t)MEM_PAGE_SIZE - 1); }
+
+static uintptr_t align_down(uintptr_t addr) { return addr & ~((uintptr_t)MEM_PAGE_SIZE - 1); }
+
+void pmm_init(const struct stivale2_struct_tag_memmap *memmap) {
+    // Cover everything up to the end of the last usable region
+    uintptr_t usable_end = 0;
+    for (uint64_t i = 0; i < memmap->entries; i++) {
+        const struct stivale2_mmap_entry *entry = &memmap->memmap[i];
+        if (entry->type == STIVALE2_MMAP_USABLE && align_down(entry->base + entry->length) > usable_end) {
+            usable_end = align_down(entry->base + entry->length);
+        }
+    }
+    FRAMES_NUM = usable_end / MEM_PAGE_SIZE;
+
+    // The bitmaps and refcounts are carved out of the start of the first usable region large enough to hold them
+    size_t bitmaps_size = 0;
+    for (uint8_t order = 0; order <= PMM_ORDER_MAX; order++) {
+        bitmaps_size += bitmap_size(order);
+    }
+    bitmaps_size = align_up(bitmaps_size + (FRAMES_NUM * sizeof(uint16_t)));
+    uintptr_t bitmaps_phys = 0;
+    bool bitmaps_placed = false;
+    for (uint64_t i = 0; i < memmap->entries && !bitmaps_placed; i++) {
+        const struct stivale2_mmap_entry *entry = &memmap->memmap[i];
+        const uintptr_t base = align_up(entry->base);
+        const uintptr_t end = align_down(entry->base + entry->length);
+        if (entry->type == STIVALE2_MMAP_USABLE && end > base && end - base >= bitmaps_size) {
+            bitmaps_phys = base;
+            bitmaps_placed = true;
+        }
+    }
+    if (!bitmaps_placed) {
+        kpanicf("%s: No usable region can hold the %lu bytes of bitmaps\n", __func__, bitmaps_size);
+    }
+    uint8_t *bitmaps = mem_phys_to_virt(bitmaps_phys);
+    memset(bitmaps, 0, bitmaps_size);
+    for (uint8_t order = 0; order <= PMM_ORDER_MAX; order++) {
+        FREE_BITMAPS[order] = bitmaps;
+        bitmaps += bitmap_size(order);
+    }
+    REFCOUNTS = (uint16_t *)bitmaps;
+
+    // Memory reclaimable from the bootloader is left alone, as the bootloader's data structures are still in use
+    for (uint64_t i = 0; i < memmap->entries; i++) {
+        const struct stivale2_mmap_entry *entry = &memmap->memmap[i];
+        if (entry->type != STIVALE2_MMAP_USABLE) {
+            continue;
+        }
+        uintptr_t base = align_up(entry->base);
+        const uintptr_t end = align_down(entry->base + entry->length);
+        if (base == bitmaps_phys) {
+            base += bitmaps_size;
+        }
+        if (end > base) {
+            free_range(base / MEM_PAGE_SIZE, end / MEM_PAGE_SIZE);
+        }
+    }
+
+    kprintf("%s: %lu KiB free, %lu KiB used by bitmaps and refcounts\n", __func__, (FREE_FRAMES * MEM_PAGE_SIZE) / 1024,
+            bitmaps_size / 1024);
+}
+
+int pmm_alloc(uint8_t order, uintptr_t *phys) {
+    if (order > PMM_ORDER_MAX) {
+        return -1;
+    }
+
+    struct mcslock_node_t node;
+    const bool interrupts_were_enabled = mcslock_acquire_irqsave(&PMM_LOCK, &node);
+
+    // Smallest order with a free block that is at least as large as requested
+    const uint32_t candidates = FREE_LISTS_NONEMPTY & ~((1U << order) - 1);
+    if (candidates == 0) {
+        mcslock_release_irqrestore(&PMM_LOCK, &node, interrupts_were_enabled);
+        return -1;
+    }
+    uint8_t block_order = (uint8_t)__builtin_ctz(candidates);
+    const size_t pfn = pfn_by_block(FREE_LISTS[block_order]);
+    free_list_remove(block_order, pfn);
+
+    // Split off the upper halves until the block has the requested size
+    while (block_order > order) {
+        block_order--;
+        free_list_push(block_order, pfn + ((size_t)1 << block_order));
+    }
+    FREE_FRAMES -= (size_t)1 << order;
+
+    mcslock_release_irqrestore(&PMM_LOCK, &node, interrupts_were_enabled);
+
+    REFCOUNTS[pfn] = 1;
+    *phys = pfn * MEM_PAGE_SIZE;
+    return 0;
+}
+
+void pmm_free(uintptr_t phys, uint8_t order) {
+    const size_t pfn = phys / MEM_PAGE_SIZE;
+    if (order > PMM_ORDER_MAX || phys % ((uintptr_t)MEM_PAGE_SIZE << order) != 0 ||
+        pfn + ((size_t)1 << order) > FRAMES_NUM) {
+        kpanicf("%s: Invalid block 0x%lx of order %u\n", __func__, phys, order);
+    }
+
+    struct mcslock_node_t node;
+    const bool interrupts_were_enabled = mcslock_acquire_irqsave(&PMM_LOCK, &node);
+
+    if (bitmap_get(order, pfn)) {
+        kpanicf("%s: Block 0x%lx of order %u is already free\n", __func__, phys, order);
+    }
+    REFCOUNTS[pfn] = 0;
+    free_block(pfn, order);
+
+    mcslock_release_irqrestore(&PMM_LOCK, &node, interrupts_were_enabled);
+}
+
+void pmm_split(uintptr_t phys, uint8_t order) {
+    const size_t pfn = phys / MEM_PAGE_SIZE;
+    if (order > PMM_ORDER_MAX || phys % ((uintptr_t)MEM_PAGE_SIZE << order) != 0 ||
+        pfn + ((size_t)1 << order) > FRAMES_NUM || REFCOUNTS[pfn] == 0) {
+        kpanicf("%s: Invalid block 0x%lx of order %u\n", __func__, phys, order);
+    }
+    for (size_t i = 1; i < ((size_t)1 << order); i++) {
+        REFCOUNTS[pfn + i] = 1;
+    }
+}
+
+size_t pmm_free_frames(void) { return FREE_FRAMES; }
+
+/// Find the refcount of an allocated frame, panicking if it's not.
+static uint16_t *refcount_by_phys(uintptr_t phys) {
+    const size_t pfn = phys / MEM_PAGE_SIZE;
+    if (pfn >= FRAMES_NUM || REFCOUNTS[pfn] == 0) {
+        kpanicf("%s: Frame 0x%lx is not allocated\n", __func__, phys);
+    }
+    return &REFCOUNTS[pfn];
+}
+
+void pmm_ref(uintptr_t phys) {
+    struct mcslock_node_t node;
+    const bool interrupts_were_enabled = mcslock_acquire_irqsave(&PMM_LOCK, &node);
+
+    uint16_t *refcount = refcount_by_phys(phys);
+    if (*refcount == UINT16_MAX) {
+        kpanicf("%s: Too many references to frame 0x%lx\n", __func__, phys);
+    }
+    (*refcount)++;
+
+    mcslock_release_irqrestore(&PMM_LOCK, &node, interrupts_were_enabled);
+}
+
+void pmm_unref(uintptr_t phys) {
+    struct mcslock_node_t node;
+    const bool interrupts_were_enabled = mcslock_acquire_irqsave(&PMM_LOCK, &node);
+
+    uint16_t *refcount = refcount_by_phys(phys);
+    (*refcount)--;
+    if (*refcount == 0) {
+        free_block(phys / MEM_PAGE_SIZE, 0);
+    }
+
+    mcslock_release_irqrestore(&PMM_LOCK, &node, interrupts_were_enabled);
+}
+
+uint16_t pmm_refcount(uintptr_t phys) {
+    const size_t pfn = phys / MEM_PAGE_SIZE;
+    return pfn < FRAMES_NUM ? REFCOUNTS[pfn] : 0;
+}
@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "include/exception.h"
+#include "include/interrupt.h"
+#include "include/spinlock.h"
+#include "internal.h"
+#include "kmalloc.h"
+#include "mem.h"
+#include "pmm.h"
+#include "vmm.h"
+
+static uintptr_t ZERO_PAGE = 0;
+
+uintptr_t region_zero_page(void) { return ZERO_PAGE; }
+
+static uintptr_t page_align_down(uintptr_t addr) { return addr & ~((uintptr_t)MEM_PAGE_SIZE - 1); }
+
+/// Address space whose region list covers the given address.
+///
+/// Regions in the kernel's half are kept by the kernel's address space, as that half is shared by all of them.
+static struct vmm_address_space_t *space_by_addr(uintptr_t addr) {
+    return addr >= MEM_KERNEL_HALF_BASE ? vmm_address_space_kernel() : vmm_address_space_active();
+}
+
+/// Find the region containing the address.
+///
+/// Return NULL if the address is not within a region.
+static struct region_t *region_find(uintptr_t addr) {
+    for (struct region_t *r = space_by_addr(addr)->regions; r != NULL && r->start <= addr; r = r->next) {
+        if (addr < r->end) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/// Back the page with a fresh zeroed frame, replacing the zero page if it's mapped there.
+///
+/// Other CPUs may keep reading the zero page until the batch is flushed.
+///
+/// `VMM_LOCK` must be held.
+static void commit(uintptr_t page, uint64_t flags, struct tlb_batch_t *batch) {
+    uintptr_t phys;
+    if (vmm_unmap_locked(page, &phys, batch) == 0 && phys != ZERO_PAGE) {
+        kpanicf("%s: Page %p is backed already\n", __func__, page);
+    }
+    if (pmm_alloc(0, &phys) != 0) {
+        kpanicf("%s: Out of memory while backing page %p\n", __func__, page);
+    }
+    memset(mem_phys_to_virt(phys), 0, MEM_PAGE_SIZE);
+    if (vmm_map_locked(page, phys, flags) != 0) {
+        kpanicf("%s: Failed to map page %p\n", __func__, page);
+    }
+}
+
+/// Back the faulting page if it's within a region, with `VMM_LOCK` held.
+///
+/// Another CPU may have backed the page since the fault, which is handled by just retrying the access.
+static bool region_pf_locked(uint64_t fault_addr, uint64_t err, struct tlb_batch_t *batch) {
+    const struct region_t *r = region_find(fault_addr);
+    if (r == NULL) {
+        return false;
+    }
+    const uintptr_t page = page_align_down(fault_addr);
+    const bool write = (err & PF_ERR_WRITE) != 0;
+    const bool writable = (r->flags & VMM_FLAG_WRITABLE) != 0;
+
+    uintptr_t phys;
+    const bool mapped = vmm_translate_locked(page, &phys) == 0;
+    if (!mapped) {
+        if (write || !writable) {
+            commit(page, r->flags, batch);
+        } else {
+            // Reads don't need a frame of their own until the first write
+            if (vmm_map_locked(page, ZERO_PAGE, r->flags & ~VMM_FLAG_WRITABLE) != 0) {
+                kpanicf("%s: Failed to map zero page at %p\n", __func__, page);
+            }
+        }
+        return true;
+    }
+    if ((err & PF_ERR_PRESENT) == 0) {
+        return true;
+    }
+
+    // Writing to a page that's only backed by the zero page so far
+    if (write && writable && phys == ZERO_PAGE) {
+        commit(page, r->flags, batch);
+        return true;
+    }
+    return false;
+}
+
+/// Back pages in regions on first access.
+static bool region_pf(uint64_t fault_addr, uint64_t err, struct interrupt_isr_data_t *data) {
+    (void)data;
+    spinlock_acquire(&VMM_LOCK);
+    struct tlb_batch_t batch;
+    tlb_batch_init(&batch, vmm_address_space_active());
+    const bool handled = region_pf_locked(fault_addr, err, &batch);
+    spinlock_release(&VMM_LOCK);
+    tlb_batch_flush(&batch);
+    return handled;
+}
+
+void region_init(void) {
+    if (pmm_alloc(0, &ZERO_PAGE) != 0) {
+        kpanicf("%s: Failed to allocate zero page\n", __func__);
+    }
+    memset(mem_phys_to_virt(ZERO_PAGE), 0, MEM_PAGE_SIZE);
+    exception_pf_hook_register(region_pf);
+}
+
+int vmm_reserve(uintptr_t virt, size_t size, uint64_t flags) {
+    if (virt % MEM_PAGE_SIZE != 0 || size % MEM_PAGE_SIZE != 0 || size == 0) {
+        return -1;
+    }
+    struct region_t *region = kmalloc(sizeof(struct region_t));
+    if (region == NULL) {
+        return -1;
+    }
+    region->start = virt;
+    region->end = virt + size;
+    region->flags = flags;
+
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    // Find the regions this one goes between, which it must not overlap
+    struct region_t **link = &space_by_addr(virt)->regions;
+    while (*link != NULL && (*link)->end <= region->start) {
+        link = &(*link)->next;
+    }
+    int ret = -1;
+    if (*link == NULL || (*link)->start >= region->end) {
+        region->next = *link;
+        *link = region;
+        ret = 0;
+    }
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    if (ret != 0) {
+        kfree(region);
+    }
+    return ret;
+}
+
+/// Drop the reference a region's page held to it's frame.
+///
+/// Pages that were never touched aren't mapped at all, others may be shared with clones of the address space.
+static void frame_release(uintptr_t phys, void *ctx) {
+    (void)ctx;
+    if (phys != ZERO_PAGE) {
+        pmm_unref(phys);
+    }
+}
+
+int vmm_release(uintptr_t virt) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    struct region_t **link = &space_by_addr(virt)->regions;
+    while (*link != NULL && (*link)->start != virt) {
+        link = &(*link)->next;
+    }
+    struct region_t *region = *link;
+    if (region != NULL) {
+        *link = region->next;
+    }
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    if (region == NULL) {
+        return -1;
+    }
+
+    vmm_unmap_range(region->start, region->end - region->start, frame_release, NULL);
+    kfree(region);
+    return 0;
+}
+
+int region_clone(const struct vmm_address_space_t *src, struct vmm_address_space_t *dst) {
+    struct region_t **link = &dst->regions;
+    for (const struct region_t *r = src->regions; r != NULL; r = r->next) {
+        struct region_t *copy = kmalloc(sizeof(struct region_t));
+        if (copy == NULL) {
+            return -1;
+        }
+        *copy = *r;
+        copy->next = NULL;
+        *link = copy;
+        link = &copy->next;
+    }
+    return 0;
+}
+
+void region_destroy_all(struct vmm_address_space_t *space) {
+    while (space->regions != NULL) {
+        struct region_t *next = space->regions->next;
+        kfree(space->regions);
+        space->regions = next;
+    }
+}
@@ -0,0 +1,151 @@
+#include "slab.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "include/spinlock.h"
+#include "internal.h"
+#include "mem.h"
+#include "pmm.h"
+
+/// Slabs are made large enough to hold at least this many objects, unless that exceeds the largest block.
+static const size_t SLAB_OBJECTS_MIN = 3;
+
+static size_t align_up(size_t value, size_t align) { return (value + align - 1) & ~(align - 1); }
+
+void slab_cache_init(struct slab_cache_t *cache, const char *name, size_t object_size) {
+    // Free objects hold the free list pointer
+    if (object_size < sizeof(void *)) {
+        object_size = sizeof(void *);
+    }
+    size_t align = SLAB_CACHE_LINE_SIZE;
+    if (object_size < SLAB_CACHE_LINE_SIZE) {
+        align = sizeof(void *);
+        while (align < object_size) {
+            align *= 2;
+        }
+    }
+
+    cache->name = name;
+    cache->object_stride = align_up(object_size, align);
+    cache->object_offset = align_up(sizeof(struct slab_t), align);
+    cache->slab_order = 0;
+    while (cache->slab_order < PMM_ORDER_MAX &&
+           (((size_t)MEM_PAGE_SIZE << cache->slab_order) - cache->object_offset) / cache->object_stride <
+               SLAB_OBJECTS_MIN) {
+        cache->slab_order++;
+    }
+    cache->objects_per_slab =
+        (((size_t)MEM_PAGE_SIZE << cache->slab_order) - cache->object_offset) / cache->object_stride;
+    if (cache->objects_per_slab == 0) {
+        kpanicf("%s: Objects of %lu bytes are too large for cache %s\n", __func__, object_size, name);
+    }
+    cache->partial = NULL;
+    cache->empty = NULL;
+    spinlock_init(&cache->lock, name);
+}
+
+/// Get a fresh slab from the physical memory manager, with all objects linked into it's free list.
+static struct slab_t *slab_create(struct slab_cache_t *cache) {
+    uintptr_t phys;
+    if (pmm_alloc(cache->slab_order, &phys) != 0) {
+        return NULL;
+    }
+    struct slab_t *slab = mem_phys_to_virt(phys);
+    slab->cache = cache;
+    slab->order = cache->slab_order;
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->used = 0;
+
+    unsigned char *objects = (unsigned char *)slab + cache->object_offset;
+    slab->free = objects;
+    for (size_t i = 0; i < cache->objects_per_slab - 1; i++) {
+        *(void **)(objects + (i * cache->object_stride)) = objects + ((i + 1) * cache->object_stride);
+    }
+    *(void **)(objects + ((cache->objects_per_slab - 1) * cache->object_stride)) = NULL;
+    return slab;
+}
+
+static void partial_push(struct slab_cache_t *cache, struct slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = cache->partial;
+    if (slab->next != NULL) {
+        slab->next->prev = slab;
+    }
+    cache->partial = slab;
+}
+
+static void partial_remove(struct slab_cache_t *cache, struct slab_t *slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        cache->partial = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+void *slab_alloc(struct slab_cache_t *cache) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&cache->lock);
+
+    struct slab_t *slab = cache->partial;
+    if (slab == NULL) {
+        slab = cache->empty;
+        cache->empty = NULL;
+        if (slab == NULL) {
+            slab = slab_create(cache);
+        }
+        if (slab != NULL) {
+            partial_push(cache, slab);
+        }
+    }
+
+    void *object = NULL;
+    if (slab != NULL) {
+        object = slab->free;
+        slab->free = *(void **)object;
+        slab->used++;
+        // Full slabs aren't tracked, they rejoin the partial list once an object is freed
+        if (slab->used == cache->objects_per_slab) {
+            partial_remove(cache, slab);
+        }
+    }
+
+    spinlock_release_irqrestore(&cache->lock, interrupts_were_enabled);
+    return object;
+}
+
+void slab_free(struct slab_cache_t *cache, void *object) {
+    // Slabs are naturally aligned blocks, so the header is found by rounding down
+    const uintptr_t slab_size = (uintptr_t)MEM_PAGE_SIZE << cache->slab_order;
+    struct slab_t *slab = (struct slab_t *)((uintptr_t)object & ~(slab_size - 1));
+    if (slab->cache != cache) {
+        kpanicf("%s: Object %p does not belong to cache %s\n", __func__, object, cache->name);
+    }
+
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&cache->lock);
+
+    *(void **)object = slab->free;
+    slab->free = object;
+    if (slab->used == cache->objects_per_slab) {
+        partial_push(cache, slab);
+    }
+    slab->used--;
+
+    if (slab->used == 0) {
+        partial_remove(cache, slab);
+        if (cache->empty == NULL) {
+            cache->empty = slab;
+        } else {
+            pmm_free(mem_virt_to_phys(slab), slab->order);
+        }
+    }
+
+    spinlock_release_irqrestore(&cache->lock, interrupts_were_enabled);
+}
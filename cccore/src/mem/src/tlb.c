@@ -0,0 +1,172 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "include/cpu.h"
+#include "include/interrupt.h"
+#include "include/ipi.h"
+#include "include/smp.h"
+#include "internal.h"
+#include "mem.h"
+#include "vmm.h"
+
+/// CPUID leaf 1 ECX flag signaling support for process-context identifiers.
+static const uint32_t CPUID_1_ECX_PCID = 1 << 17;
+
+static const uint64_t CR4_PCIDE = 1 << 17;
+
+/// Set in the value loaded into CR3 to keep the TLB entries tagged with the new PCID.
+static const uint64_t CR3_NO_FLUSH = (uint64_t)1 << 63;
+
+/// Number of process-context identifiers the CPU distinguishes.
+#define PCIDS_NUM 4096
+
+static bool PCID_ENABLED = false;
+
+/// Bit `i % 64` of entry `i / 64` is set while PCID `i` is taken.
+///
+/// PCID `0` is always taken, as it's used by address spaces whose entries are flushed on every switch.
+static uint64_t PCIDS_TAKEN[PCIDS_NUM / 64] = {1};
+
+void tlb_init(void) {
+    // Enabling them requires the PCID bits of CR3 to be clear, which they are while PCIDs are disabled
+    if ((cpu_cpuid(1, 0).ecx & CPUID_1_ECX_PCID) == 0) {
+        return;
+    }
+    cpu_write_cr4(cpu_read_cr4() | CR4_PCIDE);
+    PCID_ENABLED = true;
+}
+
+uint16_t tlb_pcid_alloc(void) {
+    if (!PCID_ENABLED) {
+        return 0;
+    }
+    for (size_t i = 0; i < PCIDS_NUM / 64; i++) {
+        if (PCIDS_TAKEN[i] != UINT64_MAX) {
+            const size_t bit = (size_t)__builtin_ctzll(~PCIDS_TAKEN[i]);
+            PCIDS_TAKEN[i] |= (uint64_t)1 << bit;
+            return (uint16_t)(i * 64 + bit);
+        }
+    }
+    // Still works, only without keeping TLB entries across switches
+    return 0;
+}
+
+void tlb_pcid_free(uint16_t pcid) {
+    // Whichever address space takes it next starts out with no CPU trusting it's cached entries
+    if (pcid != 0) {
+        PCIDS_TAKEN[pcid / 64] &= ~((uint64_t)1 << (pcid % 64));
+    }
+}
+
+uint64_t tlb_cr3(struct vmm_address_space_t *space) {
+    const uint64_t self = (uint64_t)1 << smp_cpu()->id;
+    // Being a locked instruction, this also makes the new active address space visible before the bit is checked.
+    // A CPU invalidating pages clears the bit before checking the active address space in turn,
+    // so either it sends an IPI, or this CPU sees the bit cleared and flushes.
+    const bool cached = (__atomic_fetch_or(&space->tlb_cpus, self, __ATOMIC_SEQ_CST) & self) != 0;
+    if (!PCID_ENABLED || space->pcid == 0) {
+        return space->pml4;
+    }
+    return space->pml4 | space->pcid | (cached ? CR3_NO_FLUSH : 0);
+}
+
+void tlb_batch_init(struct tlb_batch_t *batch, struct vmm_address_space_t *space) {
+    batch->space = space;
+    batch->cpu = smp_cpu()->id;
+    batch->pages_num = 0;
+    batch->kernel_half = false;
+    batch->lower_half = false;
+    batch->all = false;
+}
+
+void tlb_batch_add(struct tlb_batch_t *batch, uintptr_t page) {
+    // The kernel's half is mapped global, so this drops the page whatever the PCID
+    cpu_invlpg(page);
+    if (page >= MEM_KERNEL_HALF_BASE) {
+        batch->kernel_half = true;
+    } else {
+        batch->lower_half = true;
+    }
+    if (batch->pages_num < TLB_BATCH_PAGES_MAX) {
+        batch->pages[batch->pages_num] = page;
+    }
+    batch->pages_num++;
+}
+
+void tlb_batch_add_all(struct tlb_batch_t *batch) {
+    if (vmm_address_space_active() == batch->space) {
+        // Reloading CR3 without keeping entries flushes all non-global ones of the current PCID
+        cpu_write_cr3(cpu_read_cr3());
+    }
+    batch->lower_half = true;
+    batch->all = true;
+}
+
+/// Invalidate the batch on the calling CPU, which another one asked to do.
+static void shootdown(void *arg) {
+    struct tlb_batch_t *batch = arg;
+    const bool overflow = batch->pages_num > TLB_BATCH_PAGES_MAX;
+    if (overflow && batch->kernel_half) {
+        // Toggling global pages off flushes everything, for all PCIDs
+        const uint64_t cr4 = cpu_read_cr4();
+        cpu_write_cr4(cr4 & ~CR4_PGE);
+        cpu_write_cr4(cr4);
+    } else {
+        if (overflow || batch->all) {
+            cpu_write_cr3(cpu_read_cr3());
+        }
+        if (!overflow) {
+            for (size_t i = 0; i < batch->pages_num; i++) {
+                cpu_invlpg(batch->pages[i]);
+            }
+        }
+    }
+
+    // Still running in the address space, so it's entries are as fresh as the last switch would have made them.
+    // Had it switched away, it's bit stays cleared and it flushes when switching back.
+    if (batch->lower_half && vmm_address_space_active() == batch->space) {
+        __atomic_fetch_or(&batch->space->tlb_cpus, (uint64_t)1 << smp_cpu()->id, __ATOMIC_SEQ_CST);
+    }
+}
+
+/// Find the CPUs which may have any of the batch's pages cached, and need an IPI to invalidate them.
+static ipi_cpu_mask_t shootdown_targets(struct tlb_batch_t *batch) {
+    const uint64_t self = (uint64_t)1 << smp_cpu()->id;
+    ipi_cpu_mask_t targets = 0;
+    if (batch->kernel_half) {
+        targets = ~self;
+    }
+    if (batch->lower_half) {
+        // CPUs running in other address spaces don't get an IPI, instead they flush once they switch back
+        uint64_t cpus = __atomic_load_n(&batch->space->tlb_cpus, __ATOMIC_ACQUIRE) & ~self;
+        while (cpus != 0) {
+            const size_t i = (size_t)__builtin_ctzll(cpus);
+            cpus &= cpus - 1;
+            __atomic_fetch_and(&batch->space->tlb_cpus, ~((uint64_t)1 << i), __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&SMP_CPUS[i].vmm_active_space, __ATOMIC_SEQ_CST) == batch->space) {
+                targets |= (ipi_cpu_mask_t)1 << i;
+            }
+        }
+    }
+    return targets;
+}
+
+void tlb_batch_flush(struct tlb_batch_t *batch) {
+    if (batch->pages_num == 0 && !batch->all) {
+        return;
+    }
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    // The calling thread may have been migrated since adding pages, leaving the TLB of this CPU untouched
+    if (smp_cpu()->id != batch->cpu) {
+        shootdown(batch);
+    }
+    const ipi_cpu_mask_t targets = shootdown_targets(batch);
+    if (targets != 0) {
+        ipi_call_mask(targets, shootdown, batch);
+    }
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
@@ -0,0 +1,571 @@
+#include "vmm.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "include/exception.h"
+#include "include/cpu.h"
+#include "include/interrupt.h"
+#include "include/smp.h"
+#include "include/spinlock.h"
+#include "internal.h"
+#include "kmalloc.h"
+#include "mem.h"
+#include "pmm.h"
+#include "stivale2.h"
+
+static const uint64_t PTE_PRESENT = (uint64_t)1 << 0;
+/// Entry maps a large page instead of pointing to the next level table.
+static const uint64_t PTE_HUGE = (uint64_t)1 << 7;
+/// Entry is write-protected because it's frame is shared, and writing to it should make a private copy.
+///
+/// One of the bits the CPU ignores.
+static const uint64_t PTE_COW = (uint64_t)1 << 9;
+/// Bits of an entry holding the physical address.
+static const uint64_t PTE_ADDR_MASK = 0x000ffffffffff000;
+/// Bits of an entry holding flags, as far as the API is concerned.
+static const uint64_t PTE_FLAGS_MASK =
+    VMM_FLAG_WRITABLE | VMM_FLAG_USER | VMM_FLAG_NO_CACHE | VMM_FLAG_GLOBAL | VMM_FLAG_NO_EXECUTE;
+
+/// Page table level of the top-level PML4, where level 0 holds the entries for 4K pages.
+static const uint8_t LEVEL_TOP = 3;
+
+/// Entries in each page table.
+#define TABLE_ENTRIES 512
+
+/// Index of the first PML4 entry belonging to the kernel's half.
+#define TABLE_IDX_KERNEL_HALF 256
+
+/// CPUID extended leaf reporting, among others, paging features.
+static const uint32_t CPUID_EXT_FEATURES = 0x80000001;
+static const uint32_t CPUID_EXT_FEATURES_EDX_NX = 1 << 20;
+static const uint32_t CPUID_EXT_FEATURES_EDX_1G_PAGES = 1 << 26;
+
+static const uint32_t MSR_EFER = 0xC0000080;
+static const uint64_t MSR_EFER_NXE = 1 << 11;
+
+/// Makes the kernel honor read-only pages as well, which copy-on-write relies on.
+static const uint64_t CR0_WP = 1 << 16;
+
+/// Physical memory below this is always direct mapped, regardless of the memory map, as it contains MMIO.
+static const uintptr_t DIRECT_MAP_SIZE_MIN = (uintptr_t)4 * 1024 * 1024 * 1024;
+
+static bool NX_SUPPORTED = false;
+static bool PAGES_1G_SUPPORTED = false;
+
+static struct vmm_address_space_t KERNEL_SPACE = {.pml4 = 0, .regions = NULL, .pcid = 0, .tlb_cpus = 0};
+
+struct spinlock_t VMM_LOCK = SPINLOCK_INIT("vmm");
+
+/// Address space the calling CPU runs in, which is the kernel's until one is activated.
+static struct vmm_address_space_t *active_space(void) {
+    struct vmm_address_space_t *space = smp_cpu()->vmm_active_space;
+    return space != NULL ? space : &KERNEL_SPACE;
+}
+
+/// Size of a page on the given level.
+static uintptr_t level_page_size(uint8_t level) { return (uintptr_t)MEM_PAGE_SIZE << (9 * level); }
+
+/// Index into the table on the given level.
+static size_t table_idx(uintptr_t virt, uint8_t level) { return (virt >> (12 + (9 * level))) & 0x1ff; }
+
+static uint64_t *table_by_phys(uintptr_t phys) { return (uint64_t *)mem_phys_to_virt(phys); }
+
+static uintptr_t active_pml4(void) { return cpu_read_cr3() & PTE_ADDR_MASK; }
+
+/// Make the address space the calling CPU's active one, with interrupts disabled.
+static void space_load(struct vmm_address_space_t *space) {
+    // Published before loading it, so that CPUs invalidating it's pages know to send an IPI
+    __atomic_store_n(&smp_cpu()->vmm_active_space, space, __ATOMIC_RELAXED);
+    cpu_write_cr3(tlb_cr3(space));
+}
+
+/// Check whether the address is within the kernel's half, which all address spaces share.
+static bool in_kernel_half(uintptr_t virt) { return table_idx(virt, LEVEL_TOP) >= TABLE_IDX_KERNEL_HALF; }
+
+/// Walk the page tables down to the entry on the given level for the given address.
+///
+/// If `create` is set, missing intermediate tables are allocated.
+///
+/// Return NULL if a table is missing, couldn't be allocated or a large page is in the way.
+static uint64_t *walk(uintptr_t pml4, uintptr_t virt, uint8_t leaf_level, bool create) {
+    uint64_t *table = table_by_phys(pml4);
+    for (uint8_t level = LEVEL_TOP; level > leaf_level; level--) {
+        uint64_t *entry = &table[table_idx(virt, level)];
+        if ((*entry & PTE_PRESENT) == 0) {
+            if (!create) {
+                return NULL;
+            }
+            uintptr_t table_phys;
+            if (pmm_alloc(0, &table_phys) != 0) {
+                return NULL;
+            }
+            memset(table_by_phys(table_phys), 0, MEM_PAGE_SIZE);
+            // Intermediate entries are permissive, the final entry decides what's allowed
+            *entry = table_phys | PTE_PRESENT | VMM_FLAG_WRITABLE | VMM_FLAG_USER;
+        } else if ((*entry & PTE_HUGE) != 0) {
+            return NULL;
+        }
+        table = table_by_phys(*entry & PTE_ADDR_MASK);
+    }
+    return &table[table_idx(virt, leaf_level)];
+}
+
+/// Find the entry mapping the page that contains the given address, whatever it's size.
+///
+/// Return NULL if the address is not mapped.
+///
+/// The level of the entry is written into the outparam.
+static uint64_t *find_leaf(uintptr_t pml4, uintptr_t virt, uint8_t *leaf_level) {
+    uint64_t *table = table_by_phys(pml4);
+    for (uint8_t level = LEVEL_TOP;; level--) {
+        uint64_t *entry = &table[table_idx(virt, level)];
+        if ((*entry & PTE_PRESENT) == 0) {
+            return NULL;
+        }
+        if (level == 0 || (*entry & PTE_HUGE) != 0) {
+            *leaf_level = level;
+            return entry;
+        }
+        table = table_by_phys(*entry & PTE_ADDR_MASK);
+    }
+}
+
+/// Turn API flags into entry flags the CPU accepts, for a page at the given address.
+static uint64_t entry_flags(uintptr_t virt, uint64_t flags) {
+    flags &= PTE_FLAGS_MASK;
+    // Would be a reserved bit otherwise
+    if (!NX_SUPPORTED) {
+        flags &= ~VMM_FLAG_NO_EXECUTE;
+    }
+    // The kernel's half is the same in every address space, and this way invalidating a page of it
+    // drops it regardless of which address space's PCID it was cached under
+    if (in_kernel_half(virt)) {
+        flags |= VMM_FLAG_GLOBAL;
+    }
+    return flags;
+}
+
+static int map_page(uintptr_t pml4, uintptr_t virt, uintptr_t phys, uint8_t level, uint64_t flags) {
+    if ((level == 2 && !PAGES_1G_SUPPORTED) || level > 2) {
+        return -1;
+    }
+    if (virt % level_page_size(level) != 0 || phys % level_page_size(level) != 0) {
+        return -1;
+    }
+    uint64_t *entry = walk(pml4, virt, level, true);
+    if (entry == NULL || (*entry & PTE_PRESENT) != 0) {
+        return -1;
+    }
+    *entry = phys | entry_flags(virt, flags) | PTE_PRESENT | (level > 0 ? PTE_HUGE : 0);
+    return 0;
+}
+
+static int map_range(uintptr_t pml4, uintptr_t virt, uintptr_t phys, size_t size, uint64_t flags) {
+    const uintptr_t end = virt + size;
+    while (virt < end) {
+        // Largest page that both addresses are aligned to and which doesn't extend past the end
+        uint8_t level = PAGES_1G_SUPPORTED ? 2 : 1;
+        while (level > 0 && (virt % level_page_size(level) != 0 || phys % level_page_size(level) != 0 ||
+                             end - virt < level_page_size(level))) {
+            level--;
+        }
+        if (map_page(pml4, virt, phys, level, flags) != 0) {
+            return -1;
+        }
+        virt += level_page_size(level);
+        phys += level_page_size(level);
+    }
+    return 0;
+}
+
+/// Give the writer a private copy of a page that's shared copy-on-write.
+static bool cow_pf(uint64_t fault_addr, uint64_t err, struct interrupt_isr_data_t *data) {
+    (void)data;
+    if ((err & (PF_ERR_PRESENT | PF_ERR_WRITE)) != (PF_ERR_PRESENT | PF_ERR_WRITE)) {
+        return false;
+    }
+    spinlock_acquire(&VMM_LOCK);
+    struct tlb_batch_t batch;
+    tlb_batch_init(&batch, active_space());
+    uint8_t level;
+    uint64_t *entry = find_leaf(active_pml4(), fault_addr, &level);
+    if (entry == NULL || level != 0 || (*entry & PTE_COW) == 0) {
+        // Another CPU may have copied the page for a write of it's own already
+        const bool resolved = entry != NULL && (*entry & VMM_FLAG_WRITABLE) != 0;
+        spinlock_release(&VMM_LOCK);
+        return resolved;
+    }
+
+    const uintptr_t phys = *entry & PTE_ADDR_MASK;
+    const uint64_t flags = (*entry & ~(PTE_ADDR_MASK | PTE_COW)) | VMM_FLAG_WRITABLE;
+    const bool private = pmm_refcount(phys) == 1;
+    if (private) {
+        // Everyone else let go of the frame already, so it's private now.
+        // Other CPUs still having it cached read-only fault, and find it resolved.
+        *entry = phys | flags;
+        cpu_invlpg(fault_addr);
+    } else {
+        uintptr_t copy;
+        if (pmm_alloc(0, &copy) != 0) {
+            kpanicf("%s: Out of memory while copying page at %p\n", __func__, fault_addr);
+        }
+        memcpy(mem_phys_to_virt(copy), mem_phys_to_virt(phys), MEM_PAGE_SIZE);
+        *entry = copy | flags;
+        tlb_batch_add(&batch, fault_addr);
+    }
+    spinlock_release(&VMM_LOCK);
+
+    // Other CPUs may read the shared frame through the old entry until they invalidated it
+    if (!private) {
+        tlb_batch_flush(&batch);
+        pmm_unref(phys);
+    }
+    return true;
+}
+
+/// Turn on the paging features the kernel's page tables rely on, on the calling CPU.
+static void paging_features_enable(void) {
+    if (NX_SUPPORTED) {
+        cpu_wrmsr(MSR_EFER, cpu_rdmsr(MSR_EFER) | MSR_EFER_NXE);
+    }
+    cpu_write_cr4(cpu_read_cr4() | CR4_PGE);
+    cpu_write_cr0(cpu_read_cr0() | CR0_WP);
+    tlb_init();
+}
+
+void vmm_init(const struct stivale2_struct_tag_memmap *memmap, const struct stivale2_struct_tag_pmrs *pmrs) {
+    if (cpu_cpuid(CPUID_EXT_FEATURES & 0x80000000, 0).eax >= CPUID_EXT_FEATURES) {
+        const struct cpu_cpuid_t features = cpu_cpuid(CPUID_EXT_FEATURES, 0);
+        NX_SUPPORTED = (features.edx & CPUID_EXT_FEATURES_EDX_NX) != 0;
+        PAGES_1G_SUPPORTED = (features.edx & CPUID_EXT_FEATURES_EDX_1G_PAGES) != 0;
+    }
+    paging_features_enable();
+
+    uintptr_t pml4;
+    if (pmm_alloc(0, &pml4) != 0) {
+        kpanicf("%s: Failed to allocate PML4\n", __func__);
+    }
+    memset(table_by_phys(pml4), 0, MEM_PAGE_SIZE);
+
+    // Direct map everything the memory map mentions, including holes, in as few pages as possible
+    uintptr_t direct_map_size = DIRECT_MAP_SIZE_MIN;
+    for (uint64_t i = 0; i < memmap->entries; i++) {
+        const struct stivale2_mmap_entry *entry = &memmap->memmap[i];
+        if (entry->base + entry->length > direct_map_size) {
+            direct_map_size = entry->base + entry->length;
+        }
+    }
+    const uintptr_t direct_map_align = level_page_size(1);
+    direct_map_size = (direct_map_size + direct_map_align - 1) & ~(direct_map_align - 1);
+    if (map_range(pml4, (uintptr_t)mem_phys_to_virt(0), 0, direct_map_size,
+                  VMM_FLAG_WRITABLE | VMM_FLAG_GLOBAL | VMM_FLAG_NO_EXECUTE) != 0) {
+        kpanicf("%s: Failed to set up direct map\n", __func__);
+    }
+
+    // Kernel image, with the permissions it's ELF segments ask for
+    if (pmrs == NULL) {
+        kpanicf("%s: Bootloader did not pass the kernel's protected memory ranges\n", __func__);
+    }
+    for (uint64_t i = 0; i < pmrs->entries; i++) {
+        const struct stivale2_pmr *pmr = &pmrs->pmrs[i];
+        const uintptr_t base = pmr->base & ~((uintptr_t)MEM_PAGE_SIZE - 1);
+        const uintptr_t end = (pmr->base + pmr->length + MEM_PAGE_SIZE - 1) & ~((uintptr_t)MEM_PAGE_SIZE - 1);
+        uint64_t flags = VMM_FLAG_GLOBAL;
+        if ((pmr->permissions & STIVALE2_PMR_WRITABLE) != 0) {
+            flags |= VMM_FLAG_WRITABLE;
+        }
+        if ((pmr->permissions & STIVALE2_PMR_EXECUTABLE) == 0) {
+            flags |= VMM_FLAG_NO_EXECUTE;
+        }
+        if (map_range(pml4, base, mem_virt_to_phys((const void *)base), end - base, flags) != 0) {
+            kpanicf("%s: Failed to map kernel range %p-%p\n", __func__, base, end);
+        }
+    }
+
+    // Every table of the kernel's half exists from the start, so that address spaces can share them
+    uint64_t *pml4_table = table_by_phys(pml4);
+    for (size_t i = TABLE_IDX_KERNEL_HALF; i < TABLE_ENTRIES; i++) {
+        if ((pml4_table[i] & PTE_PRESENT) != 0) {
+            continue;
+        }
+        uintptr_t table_phys;
+        if (pmm_alloc(0, &table_phys) != 0) {
+            kpanicf("%s: Failed to allocate kernel page tables\n", __func__);
+        }
+        memset(table_by_phys(table_phys), 0, MEM_PAGE_SIZE);
+        pml4_table[i] = table_phys | PTE_PRESENT | VMM_FLAG_WRITABLE | VMM_FLAG_USER;
+    }
+
+    KERNEL_SPACE.pml4 = pml4;
+    space_load(&KERNEL_SPACE);
+    region_init();
+    exception_pf_hook_register(cow_pf);
+    kprintf("%s: Direct mapped %lu MiB with %s pages\n", __func__, direct_map_size / (1024 * 1024),
+            PAGES_1G_SUPPORTED ? "1G" : "2M");
+}
+
+void vmm_init_ap(void) {
+    paging_features_enable();
+    space_load(&KERNEL_SPACE);
+}
+
+bool vmm_page_size_supported(enum vmm_page_size_t size) {
+    return size == VMM_PAGE_SIZE_4K || size == VMM_PAGE_SIZE_2M || (size == VMM_PAGE_SIZE_1G && PAGES_1G_SUPPORTED);
+}
+
+int vmm_map_locked(uintptr_t virt, uintptr_t phys, uint64_t flags) {
+    return map_page(active_pml4(), virt, phys, 0, flags);
+}
+
+int vmm_map_page(uintptr_t virt, uintptr_t phys, enum vmm_page_size_t size, uint64_t flags) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    const int ret = map_page(active_pml4(), virt, phys, (uint8_t)size, flags);
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    return ret;
+}
+
+int vmm_map(uintptr_t virt, uintptr_t phys, uint64_t flags) {
+    return vmm_map_page(virt, phys, VMM_PAGE_SIZE_4K, flags);
+}
+
+int vmm_map_range(uintptr_t virt, uintptr_t phys, size_t size, uint64_t flags) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    const int ret = map_range(active_pml4(), virt, phys, size, flags);
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    return ret;
+}
+
+int vmm_unmap_locked(uintptr_t virt, uintptr_t *phys, struct tlb_batch_t *batch) {
+    uint8_t level;
+    uint64_t *entry = find_leaf(active_pml4(), virt, &level);
+    if (entry == NULL || virt % level_page_size(level) != 0) {
+        return -1;
+    }
+    *phys = *entry & PTE_ADDR_MASK & ~(level_page_size(level) - 1);
+    *entry = 0;
+    // A single invlpg drops the translation for the whole page, whatever it's size
+    tlb_batch_add(batch, virt);
+    return 0;
+}
+
+int vmm_unmap(uintptr_t virt, uintptr_t *phys) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    struct tlb_batch_t batch;
+    tlb_batch_init(&batch, active_space());
+    const int ret = vmm_unmap_locked(virt, phys, &batch);
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    tlb_batch_flush(&batch);
+    return ret;
+}
+
+void vmm_unmap_range(uintptr_t virt, size_t size, vmm_frame_release_t release, void *ctx) {
+    const uintptr_t end = virt + size;
+    while (virt < end) {
+        // Frames may only be released once the batch is flushed, so a batch holds as many as it tracks one by one
+        uintptr_t frames[TLB_BATCH_PAGES_MAX];
+        size_t frames_num = 0;
+        struct tlb_batch_t batch;
+        const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+        tlb_batch_init(&batch, active_space());
+        for (; virt < end && frames_num < TLB_BATCH_PAGES_MAX; virt += MEM_PAGE_SIZE) {
+            if (vmm_unmap_locked(virt, &frames[frames_num], &batch) == 0) {
+                frames_num++;
+            }
+        }
+
+        spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+        tlb_batch_flush(&batch);
+        for (size_t i = 0; i < frames_num; i++) {
+            release(frames[i], ctx);
+        }
+    }
+}
+
+int vmm_protect(uintptr_t virt, uint64_t flags) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    struct tlb_batch_t batch;
+    tlb_batch_init(&batch, active_space());
+    int ret = -1;
+    uint8_t level;
+    uint64_t *entry = find_leaf(active_pml4(), virt, &level);
+    if (entry != NULL) {
+        uint64_t preserved = *entry & (PTE_ADDR_MASK | PTE_HUGE);
+        // A shared frame stays write-protected until the write fault copies it
+        if ((*entry & PTE_COW) != 0 && (flags & VMM_FLAG_WRITABLE) != 0) {
+            preserved |= PTE_COW;
+            flags &= ~VMM_FLAG_WRITABLE;
+        }
+        *entry = preserved | entry_flags(virt, flags) | PTE_PRESENT;
+        tlb_batch_add(&batch, virt & ~(level_page_size(level) - 1));
+        ret = 0;
+    }
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    tlb_batch_flush(&batch);
+    return ret;
+}
+
+int vmm_translate_locked(uintptr_t virt, uintptr_t *phys) {
+    uint8_t level;
+    const uint64_t *entry = find_leaf(active_pml4(), virt, &level);
+    if (entry == NULL) {
+        return -1;
+    }
+    const uintptr_t page_mask = level_page_size(level) - 1;
+    *phys = (*entry & PTE_ADDR_MASK & ~page_mask) | (virt & page_mask);
+    return 0;
+}
+
+int vmm_translate(uintptr_t virt, uintptr_t *phys) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    const int ret = vmm_translate_locked(virt, phys);
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    return ret;
+}
+
+struct vmm_address_space_t *vmm_address_space_kernel(void) { return &KERNEL_SPACE; }
+
+struct vmm_address_space_t *vmm_address_space_active(void) { return active_space(); }
+
+void vmm_address_space_activate(struct vmm_address_space_t *space) {
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    if (space != active_space()) {
+        // The kernel's half is global, so at most the lower half's TLB entries are flushed
+        space_load(space);
+    }
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+}
+
+/// Share all pages mapped by a table of the lower half with a new table, write-protecting writable ones.
+///
+/// Return `-1` if a large page is encountered or a table could not be allocated.
+/// The new table's entries up to that point are valid, so it can be destroyed.
+///
+/// Return `0` on success.
+static int clone_table(uint64_t *src, uint64_t *dst, uint8_t level, size_t entries) {
+    for (size_t i = 0; i < entries; i++) {
+        if ((src[i] & PTE_PRESENT) == 0) {
+            continue;
+        }
+        if (level == 0) {
+            const uintptr_t phys = src[i] & PTE_ADDR_MASK;
+            if (phys != region_zero_page()) {
+                if ((src[i] & VMM_FLAG_WRITABLE) != 0) {
+                    src[i] = (src[i] & ~VMM_FLAG_WRITABLE) | PTE_COW;
+                }
+                pmm_ref(phys);
+            }
+            dst[i] = src[i];
+            continue;
+        }
+        if ((src[i] & PTE_HUGE) != 0) {
+            return -1;
+        }
+        uintptr_t table_phys;
+        if (pmm_alloc(0, &table_phys) != 0) {
+            return -1;
+        }
+        memset(table_by_phys(table_phys), 0, MEM_PAGE_SIZE);
+        dst[i] = table_phys | (src[i] & ~PTE_ADDR_MASK);
+        if (clone_table(table_by_phys(src[i] & PTE_ADDR_MASK), table_by_phys(table_phys), level - 1,
+                        TABLE_ENTRIES) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/// Drop the references of a table of the lower half to all frames it maps, and free all tables below it.
+static void destroy_table(uint64_t *table, uint8_t level, size_t entries) {
+    for (size_t i = 0; i < entries; i++) {
+        if ((table[i] & PTE_PRESENT) == 0) {
+            continue;
+        }
+        const uintptr_t phys = table[i] & PTE_ADDR_MASK;
+        if (level == 0) {
+            if (phys != region_zero_page()) {
+                pmm_unref(phys);
+            }
+        } else if ((table[i] & PTE_HUGE) == 0) {
+            destroy_table(table_by_phys(phys), level - 1, TABLE_ENTRIES);
+            pmm_free(phys, 0);
+        }
+    }
+}
+
+void vmm_address_space_destroy(struct vmm_address_space_t *space) {
+    if (space == &KERNEL_SPACE) {
+        kpanicf("%s: Can't destroy the kernel address space\n", __func__);
+    }
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+    // Activating takes the lock as well, so no CPU can switch to the address space while it's torn down.
+    // A CPU that ran in it before may still cache it's translations, but flushes them before reusing the PCID.
+    for (size_t i = 0; i < smp_cpu_count(); i++) {
+        if (__atomic_load_n(&SMP_CPUS[i].vmm_active_space, __ATOMIC_RELAXED) == space) {
+            kpanicf("%s: Can't destroy the address space active on CPU %lu\n", __func__, i);
+        }
+    }
+
+    destroy_table(table_by_phys(space->pml4), LEVEL_TOP, TABLE_IDX_KERNEL_HALF);
+    tlb_pcid_free(space->pcid);
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    pmm_free(space->pml4, 0);
+    region_destroy_all(space);
+    kfree(space);
+}
+
+int vmm_address_space_clone(struct vmm_address_space_t *src, struct vmm_address_space_t **clone) {
+    struct vmm_address_space_t *space = kmalloc(sizeof(struct vmm_address_space_t));
+    if (space == NULL) {
+        return -1;
+    }
+    space->regions = NULL;
+    if (pmm_alloc(0, &space->pml4) != 0) {
+        kfree(space);
+        return -1;
+    }
+    uint64_t *pml4 = table_by_phys(space->pml4);
+    memset(pml4, 0, MEM_PAGE_SIZE);
+    // The kernel's half points to the same tables everywhere
+    memcpy(&pml4[TABLE_IDX_KERNEL_HALF], &table_by_phys(KERNEL_SPACE.pml4)[TABLE_IDX_KERNEL_HALF],
+           (TABLE_ENTRIES - TABLE_IDX_KERNEL_HALF) * sizeof(uint64_t));
+
+    const bool interrupts_were_enabled = spinlock_acquire_irqsave(&VMM_LOCK);
+
+    space->pcid = tlb_pcid_alloc();
+    space->tlb_cpus = 0;
+    int ret = clone_table(table_by_phys(src->pml4), pml4, LEVEL_TOP, TABLE_IDX_KERNEL_HALF);
+    if (ret == 0) {
+        ret = region_clone(src, space);
+    }
+    // Pages of the source that were write-protected may still be writable in the TLB of every CPU running it
+    struct tlb_batch_t batch;
+    tlb_batch_init(&batch, src);
+    tlb_batch_add_all(&batch);
+
+    spinlock_release_irqrestore(&VMM_LOCK, interrupts_were_enabled);
+    tlb_batch_flush(&batch);
+    if (ret != 0) {
+        vmm_address_space_destroy(space);
+        return -1;
+    }
+    *clone = space;
+    return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../src/tcb.h"
+
+//! Synchronous message passing between threads.
+//!
+//! A message is only ever transferred when both sender and receiver are ready for it, so nothing is buffered.
+//! Messages are short enough to travel in registers,
+//! and the kernel switches straight from sender to receiver without asking the scheduler whenever it can.
+
+/// Number of words in a message.
+#define IPC_MSG_WORDS 6
+
+/// Interrupt vector through which threads enter the kernel for IPC.
+#define IPC_VECTOR 0x80
+
+/// Partner for receiving from whichever thread sends first.
+#define IPC_TID_ANY ((thread_tid_t)UINT64_MAX)
+
+/// A message, which travels in registers.
+struct ipc_msg_t {
+    uint64_t words[IPC_MSG_WORDS];
+};
+
+/// Register the kernel's IPC entry point.
+///
+/// Interrupt subsystem must be initialized before calling this.
+void ipc_init(void);
+
+/// Send a message, blocking until the receiver takes it.
+///
+/// Return `-1` if the receiver does not exist, or stops existing while the sender is blocked.
+///
+/// Return `0` on success.
+int ipc_send(thread_tid_t dest, const struct ipc_msg_t *msg);
+
+/// Receive a message from the given thread, or from anyone if `IPC_TID_ANY` is given, blocking until one is sent.
+///
+/// Return `-1` if the sender does not exist, or stops existing while the receiver is blocked.
+///
+/// Return `0` on success.
+///
+/// The sender's TID and the message are written into the outparams.
+int ipc_recv(thread_tid_t src, thread_tid_t *sender, struct ipc_msg_t *msg);
+
+/// Send a message and receive the reply to it in one go, which is how clients talk to servers.
+///
+/// The receiver must reply using `ipc_reply_recv`.
+///
+/// Return `-1` if the receiver does not exist, or stops existing before replying.
+///
+/// Return `0` on success.
+///
+/// The reply is written into `msg`.
+int ipc_call(thread_tid_t dest, struct ipc_msg_t *msg);
+
+/// Reply to a thread blocked in `ipc_call`, and receive the next message from anyone in one go,
+/// which is how servers talk to clients.
+///
+/// A reply to a thread that's not waiting for one is dropped.
+///
+/// Return `-1` if receiving failed.
+///
+/// Return `0` on success.
+///
+/// The next sender's TID is written into `sender`, and it's message into `msg`.
+int ipc_reply_recv(thread_tid_t dest, thread_tid_t *sender, struct ipc_msg_t *msg);
+
+/// Start a pair of threads measuring the latency of IPC round trips, which report their results with kprintf.
+///
+/// Once they reported, the client thread calls `then` unless it's NULL.
+/// This lets another benchmark start only afterwards, rather than both competing for the CPUs.
+void ipc_bench_start(void (*then)(void));
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sync.h"
+
+//! Notification objects, for asynchronously signalling threads.
+//!
+//! A notification is a word of bits. Signalling ORs bits into it and never blocks, so interrupt handlers may do it.
+//! Waiting takes all bits at once, blocking until at least one is set.
+//! Both run in constant time, which lets interrupt handlers defer their work to threads without polling.
+
+/// A notification, which may be statically allocated.
+struct notification_t {
+    /// Bits signalled, which no waiter has taken yet.
+    uint64_t bits;
+    /// Threads blocked waiting for bits.
+    struct wait_queue_t waiters;
+};
+
+/// Initializer for a notification with no bits set.
+#define NOTIFICATION_INIT \
+    { .bits = 0, .waiters = WAIT_QUEUE_INIT }
+
+/// Initialize a notification with no bits set.
+void notification_init(struct notification_t *n);
+
+/// OR the given bits into the notification.
+///
+/// If threads are waiting, the longest-waiting one takes the bits and is woken instead.
+///
+/// Safe to call from interrupt handlers.
+void notification_signal(struct notification_t *n, uint64_t bits);
+
+/// Take all bits signalled on the notification, blocking until there is at least one.
+///
+/// Only call this from a thread other than an idle thread, never from an interrupt handler.
+uint64_t notification_wait(struct notification_t *n);
+
+/// Take all bits signalled on the notification, without blocking.
+///
+/// Return `0` if none are set.
+uint64_t notification_poll(struct notification_t *n);
+
+/// Signal the given bits on the notification whenever the interrupt at the given IDT slot is raised.
+///
+/// The interrupt is acknowledged right away, the thread waiting on the notification handles the device.
+/// A line raised by the interrupt controller is masked along with that, until the thread calls `notification_ack_irq`.
+/// Replaces the interrupt's previous handler, and unmasks the line if it's raised by the interrupt controller.
+///
+/// Return `-1` if the bits are zero.
+///
+/// Return `0` on success.
+int notification_bind_irq(struct notification_t *n, uint64_t bits, uint8_t idt_slot);
+
+/// Unmask the line of an interrupt bound with `notification_bind_irq` again, once the device no longer raises it.
+///
+/// Call this after handling everything the device signalled, so that a level-triggered line has been lowered.
+/// Edges raised while the line is masked are lost, so check the device for more work right after.
+/// Does nothing for message-signalled interrupts, which are never masked.
+///
+/// Return `-1` if no notification is bound to the interrupt.
+///
+/// Return `0` on success.
+int notification_ack_irq(uint8_t idt_slot);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../src/tcb.h"
+
+//! Single-producer, single-consumer rings for bulk transfers between threads.
+//!
+//! The ring lives in frames that are mapped into both endpoints, which move data in and out themselves.
+//! The kernel only gets involved when the consumer runs dry and wants to block, and for the doorbell
+//! which wakes it again. The producer only rings the doorbell when the ring goes from empty to non-empty
+//! while the consumer is waiting, so a busy stream costs no kernel entries at all.
+
+/// Control page at the start of a ring's mapping, followed by the data pages.
+///
+/// Counters only ever grow, the position in the data is the counter modulo the data size.
+/// Each field lives in a cache line of it's own, as each is written by a different endpoint.
+struct ring_shared_t {
+    /// Size of the data, in bytes, a power of two.
+    uint64_t size;
+    /// Bytes the consumer has taken out, only written by the consumer.
+    _Alignas(64) uint64_t head;
+    /// Bytes the producer has put in, only written by the producer.
+    _Alignas(64) uint64_t tail;
+    /// Set by the consumer before it blocks, cleared by the doorbell.
+    _Alignas(64) uint64_t consumer_waiting;
+};
+
+/// A ring, as the kernel keeps track of it.
+struct ring_t;
+
+/// Where an endpoint sees a ring in it's address space.
+struct ring_view_t {
+    /// The control page.
+    struct ring_shared_t *shared;
+    /// The data, which is contiguous.
+    uint8_t *data;
+};
+
+/// Create a ring with `2^order` pages of data, which only the given thread may consume from.
+///
+/// Return `-1` if the order is invalid, or memory could not be allocated.
+///
+/// Return `0` on success.
+///
+/// The ring is written into the outparam.
+int ring_create(uint8_t order, thread_tid_t consumer, struct ring_t **ring);
+
+/// Destroy a ring, dropping the kernel's references to it's frames.
+///
+/// Frames stay alive as long as they are mapped into any address space.
+/// The consumer must not be waiting on the ring.
+void ring_destroy(struct ring_t *ring);
+
+/// Size of the ring's mapping, control page included.
+size_t ring_mapping_size(const struct ring_t *ring);
+
+/// Map the ring into the lower half of the active address space, with the control page at the given address
+/// and the data right after it.
+///
+/// Each mapping holds a reference to the ring's frames, which is dropped by `ring_unmap`
+/// or when the address space is destroyed.
+///
+/// Return `-1` if the address is not page-aligned, the whole mapping doesn't fit into the canonical lower half below
+/// `MEM_LOWER_HALF_END`, or anything is mapped there already.
+/// Pages mapped before the failure are unmapped again.
+///
+/// Return `0` on success.
+///
+/// Where the ring is mapped is written into the outparam.
+int ring_map(struct ring_t *ring, uintptr_t virt, uint64_t flags, struct ring_view_t *view);
+
+/// Unmap a ring mapped by `ring_map` from the active address space.
+void ring_unmap(struct ring_t *ring, uintptr_t virt);
+
+/// Find the ring in the kernel's direct map.
+///
+/// Kernel threads may pass this view to the functions below, instead of mapping the ring.
+void ring_kernel_view(struct ring_t *ring, struct ring_view_t *view);
+
+/// Copy up to `len` bytes into the ring, ringing the doorbell if the consumer needs to be woken.
+///
+/// Only call this from the producer, through the ring's mapping in the producer's address space.
+///
+/// Return the number of bytes copied, which is less than `len` if the ring is full.
+size_t ring_write(struct ring_t *ring, const struct ring_view_t *view, const void *buf, size_t len);
+
+/// Copy up to `len` bytes out of the ring, without blocking.
+///
+/// Only call this from the consumer, through the ring's mapping in the consumer's address space.
+///
+/// Return the number of bytes copied, which is less than `len` if the ring runs empty.
+size_t ring_read(const struct ring_view_t *view, void *buf, size_t len);
+
+/// Block the consumer until the ring holds data.
+///
+/// Returns immediately if it does already.
+///
+/// Only call this from the consumer.
+void ring_wait(struct ring_t *ring, const struct ring_view_t *view);
+
+/// Wake the consumer if it's waiting on the ring.
+///
+/// `ring_write` calls this on it's own when needed, producers only call it when they fill the ring by other means.
+void ring_doorbell(struct ring_t *ring);
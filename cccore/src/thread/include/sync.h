@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../src/tcb.h"
+
+//! Blocking synchronization between threads.
+//!
+//! Waiters queue up in FIFO order, and whoever releases a resource hands it straight to the longest waiter.
+//! Only that one thread is woken, and nobody can snatch the resource from it before it gets to run.
+//! All of these may be statically allocated using their initializers.
+//!
+//! Never use them from interrupt handlers, nor from idle threads, as both may have to block.
+
+struct thread_t;
+
+/// FIFO of threads blocked on something.
+struct wait_queue_t {
+    /// Longest-waiting thread, if any.
+    struct thread_t *head;
+    /// Most recently blocked thread, if any.
+    struct thread_t *tail;
+};
+
+/// Initializer for an empty wait queue.
+#define WAIT_QUEUE_INIT \
+    { .head = NULL, .tail = NULL }
+
+/// A lock which blocks threads that have to wait for it.
+struct mutex_t {
+    /// Whether someone owns the mutex, including a waiter it was handed to that didn't run yet.
+    bool locked;
+    /// Owner of the mutex, if it's locked.
+    thread_tid_t owner;
+    /// Threads waiting for the mutex.
+    struct wait_queue_t waiters;
+};
+
+/// Initializer for an unlocked mutex.
+#define MUTEX_INIT \
+    { .locked = false, .owner = 0, .waiters = WAIT_QUEUE_INIT }
+
+/// A counting semaphore.
+struct semaphore_t {
+    /// Number of times the semaphore may be taken without blocking.
+    uint64_t count;
+    /// Threads waiting for the count to rise.
+    struct wait_queue_t waiters;
+};
+
+/// Initializer for a semaphore with the given count.
+#define SEMAPHORE_INIT(initial_count) \
+    { .count = (initial_count), .waiters = WAIT_QUEUE_INIT }
+
+/// A condition variable.
+struct condvar_t {
+    /// Threads waiting for the condition, each of which released the same mutex.
+    struct wait_queue_t waiters;
+    /// Mutex the waiters released, and get back before they return.
+    struct mutex_t *mutex;
+};
+
+/// Initializer for a condition variable nobody waits on.
+#define CONDVAR_INIT \
+    { .waiters = WAIT_QUEUE_INIT, .mutex = NULL }
+
+/// Initialize a wait queue with no threads in it.
+void wait_queue_init(struct wait_queue_t *wq);
+
+/// Initialize an unlocked mutex.
+void mutex_init(struct mutex_t *m);
+
+/// Lock the mutex, blocking until it's handed over if someone else owns it.
+///
+/// Panic if the calling thread owns it already, as mutexes aren't recursive.
+void mutex_lock(struct mutex_t *m);
+
+/// Lock the mutex if that's possible without blocking.
+///
+/// Return whether the mutex was locked.
+bool mutex_trylock(struct mutex_t *m);
+
+/// Unlock the mutex, handing it to the longest waiter if there is one.
+///
+/// Panic if the calling thread doesn't own it.
+void mutex_unlock(struct mutex_t *m);
+
+/// Initialize a semaphore with the given count.
+void semaphore_init(struct semaphore_t *s, uint64_t count);
+
+/// Take the semaphore, blocking until it's handed over if the count is zero.
+void semaphore_down(struct semaphore_t *s);
+
+/// Take the semaphore if that's possible without blocking.
+///
+/// Return whether the semaphore was taken.
+bool semaphore_trydown(struct semaphore_t *s);
+
+/// Release the semaphore, handing it to the longest waiter rather than raising the count if there is one.
+void semaphore_up(struct semaphore_t *s);
+
+/// Initialize a condition variable nobody waits on.
+void condvar_init(struct condvar_t *cv);
+
+/// Release the mutex and wait for the condition to be signalled, then get the mutex back.
+///
+/// The calling thread must own the mutex. All threads waiting at the same time must use the same mutex.
+/// As with any condition variable, recheck the condition after this returns.
+void condvar_wait(struct condvar_t *cv, struct mutex_t *m);
+
+/// Let the longest waiter of the condition variable continue, if any.
+///
+/// Rather than waking it to fight over the mutex, the waiter queues up for the mutex,
+/// or gets it right away if it's unlocked.
+void condvar_signal(struct condvar_t *cv);
+
+/// Let all waiters of the condition variable continue.
+///
+/// Waiters queue up for the mutex, so only one of them runs at a time, rather than all of them waking at once.
+void condvar_broadcast(struct condvar_t *cv);
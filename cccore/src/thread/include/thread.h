@@ -1,44 +1,101 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "../src/tcb.h"
 #include "interrupt.h"
 
-/// Prepare a switch to the given thread, by storing old thread's state and loading new thread's registers onto the
-/// stack, where the ISR will load them back into the CPU.
-void thread_switch_prepare(struct thread_cpu_state_t old_thread_cpu_state, thread_tid_t old_thread_tid,
-                           thread_tid_t new_thread_tid, struct interrupt_isr_data_t *isr_data);
+/// Prepare a switch to the given thread from within an interrupt handler.
+///
+/// The old thread's state stays where the ISR saved it on the old thread's stack,
+/// and the ISR resumes the frame the new thread was suspended with once the handler returns.
+///
+/// The lock of the calling CPU's run queues must be held. If the threads differ, it stays held until the new thread
+/// is resumed.
+void thread_switch_prepare(thread_tid_t old_thread_tid, thread_tid_t new_thread_tid,
+                           struct interrupt_isr_data_t *isr_data);
+
+/// Voluntarily give up the CPU, letting the scheduler pick another thread to run right away.
+///
+/// Returns once the calling thread is scheduled again.
+/// If no other thread is ready to run at the caller's priority or above, returns immediately.
+///
+/// Only call this from a thread, never from an interrupt handler.
+void thread_yield(void);
+
+/// Block the calling thread for at least the given duration.
+///
+/// Only call this from a thread other than an idle thread, never from an interrupt handler.
+void thread_sleep_ns(uint64_t duration_ns);
+
+/// Handle expiry of the one-shot timer.
+///
+/// Wakes sleeping threads whose deadline has passed, lets the scheduler pick the next thread to run and arms the timer
+/// for the next deadline. The timer therefore only fires when there's something to do, rather than periodically.
+///
+/// Only call this from the timer's interrupt handler.
+void thread_timer_expired(struct interrupt_isr_data_t *isr_data);
+
+/// Handle a reschedule IPI, which another CPU sends when it made a thread ready in the calling CPU's run queues.
+///
+/// Lets the scheduler pick the next thread to run if the calling CPU is idle, and arms the timer for the next deadline.
+///
+/// Only call this from the reschedule IPI's handler.
+void thread_reschedule_requested(struct interrupt_isr_data_t *isr_data);
 
-/// Kick the entire thread machinery into gear by switching to the idle thread and leaving the kernel's main function.
+/// Kick the entire thread machinery into gear by switching to the calling CPU's idle thread and leaving the kernel's
+/// main function, or the application processor's entry function.
 ///
-/// You should only call this once, and only outside an interrupt handler.
+/// You should only call this once on each CPU, and only outside an interrupt handler.
 void __attribute__((noreturn)) thread_go(void);
 
 /// Signature that all thread entrypoint functions must obey.
 typedef void (*thread_entrypoint_t)(void);
 
-/// Initialize threading.
+/// Stack size threads get unless they ask for a specific one.
+///
+/// Interrupt handlers run on stacks of their own, so it only needs room for the thread itself and one interrupt frame.
+#define THREAD_STACK_SIZE_DEFAULT (16 * 1024)
+
+/// Largest stack size a thread may ask for.
+#define THREAD_STACK_SIZE_MAX (1024 * 1024)
+
+/// Initialize threading, including an idle thread for each CPU.
 ///
-/// Only call this once.
+/// Only call this once, after `smp_init`.
 void thread_threading_init(void);
 
 /// Create a new thread.
 ///
-/// Return `-1` if thread could not be created due to lack of resources.
+/// The stack size is rounded up to whole pages, `0` selects `THREAD_STACK_SIZE_DEFAULT`.
+/// An unmapped guard page below the stack turns overflows into page faults.
+///
+/// Return `-1` if thread could not be created due to lack of resources, or the stack size exceeds
+/// `THREAD_STACK_SIZE_MAX`.
 ///
 /// Return `0` on success.
 ///
 /// The new thread's TID is written into the outparam.
-int thread_create(thread_entrypoint_t entry, thread_tid_t *tid);
+int thread_create(thread_entrypoint_t entry, size_t stack_size, thread_tid_t *tid);
 
 /// Destroy the thread and reclaim it's resources.
 ///
-/// Return `-1` if a thread with given ID does not exist.
+/// Return `-1` if a thread with given ID does not exist, is an idle thread, or is running on any CPU right now,
+/// which includes the calling thread.
 ///
 /// Return `0` on success.
 int thread_destroy(thread_tid_t tid);
 
+/// Change the scheduling priority of a thread.
+///
+/// Takes effect the next time the scheduler runs.
+///
+/// Return `-1` if a thread with given ID does not exist or the priority is invalid.
+///
+/// Return `0` on success.
+int thread_set_priority(thread_tid_t tid, thread_priority_t priority);
+
 /// Dump the thread state with kprintf.
 ///
 /// Panic when thread does not exist.
@@ -0,0 +1,45 @@
+#pragma once
+
+//! Hooks through which the threading subsystem keeps the priority scheduler's run queues up to date.
+//!
+//! Each CPU has run queues of it's own, each protected by a lock of it's own.
+//! Unless noted otherwise, the lock of the CPU whose run queues are touched must be held for all of these.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../src/internal.h"
+
+/// Initialize the run queues and locks of all CPUs.
+///
+/// Only call this once, before any thread is queued.
+void thread_sched_priority_init(void);
+
+/// Lock protecting the given CPU's run queues, along with the state of the threads queued there or running there.
+///
+/// Held by the CPU while it switches threads, until it left the old thread's stack.
+struct ticketlock_t *thread_sched_priority_lock(size_t cpu);
+
+/// Append a thread that just became ready to the run queue of it's priority, on the CPU in it's `rq_cpu`.
+///
+/// Panics if the thread is already queued.
+void thread_sched_priority_enqueue(struct thread_t *t);
+
+/// Remove a thread from the run queue of it's priority.
+///
+/// Does nothing if the thread is not queued.
+void thread_sched_priority_dequeue(struct thread_t *t);
+
+/// Check whether any thread is waiting in the calling CPU's run queues.
+bool thread_sched_priority_pending(void);
+
+/// Check whether any thread is waiting in the run queues of other CPUs, which the calling CPU could steal.
+///
+/// Takes no lock, so the answer is only a hint.
+bool thread_sched_priority_stealable(void);
+
+/// Number of threads the given CPU has stolen from others so far.
+///
+/// Takes no lock, so the answer is only a hint.
+uint64_t thread_sched_priority_steals(size_t cpu);
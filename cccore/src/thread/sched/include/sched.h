@@ -1,7 +1,7 @@
 #pragma once
 
 //! This header is the entrypoint to the scheduling system.
-//! It currently exposes only a simple round-robin scheduler.
+//! It exposes a simple round-robin scheduler and a priority-based one.
 
 #include "../../include/thread.h"
 
@@ -9,3 +9,23 @@
 ///
 /// If no threads are ready, returns the idle thread.
 thread_tid_t thread_sched_round_robin(void);
+
+/// Calculate the next thread to run based on thread priorities.
+///
+/// The most urgent ready thread of the calling CPU wins, while threads of equal priority take turns in a round-robin
+/// fashion. The active thread competes as well, queued behind the ready threads of it's own priority.
+///
+/// Runs in constant time, regardless of the number of threads.
+/// Only when the calling CPU has no thread ready, it steals one from the CPU with the most threads waiting,
+/// which takes time linear in the number of CPUs.
+///
+/// If no threads are ready anywhere, returns the calling CPU's idle thread.
+///
+/// The lock of the calling CPU's run queues must be held, see `thread_sched_priority_lock`.
+thread_tid_t thread_sched_priority(void);
+
+/// Start threads measuring how many thread switches all CPUs together manage per second,
+/// which report their results with kprintf.
+///
+/// All threads start out on the calling CPU, so the other CPUs have to steal them first.
+void thread_sched_bench_start(void);
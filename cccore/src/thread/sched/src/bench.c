@@ -0,0 +1,98 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../../common.h"
+#include "../../include/thread.h"
+#include "../include/priority.h"
+#include "../include/sched.h"
+#include "hal/include/smp.h"
+#include "hal/include/spinlock.h"
+#include "hal/include/timer.h"
+
+/// Threads yielding to each other per CPU, so that every CPU has someone to switch to.
+#define SCHED_BENCH_THREADS_PER_CPU 2
+
+/// Time for the other CPUs to steal their share of the threads before measuring.
+#define SCHED_BENCH_WARMUP_NS (100 * 1000 * 1000)
+
+/// Time that is measured.
+#define SCHED_BENCH_DURATION_NS (1000 * 1000 * 1000)
+
+/// Yields of a single thread, padded to a cache line so that threads don't slow each other down counting.
+struct sched_bench_counter_t {
+    volatile uint64_t yields;
+} __attribute__((aligned(64)));
+
+static struct sched_bench_counter_t SCHED_BENCH_COUNTERS[SMP_CPUS_MAX * SCHED_BENCH_THREADS_PER_CPU];
+
+/// Number of worker threads, each of which counts into the counter of the same index.
+static size_t SCHED_BENCH_WORKERS_NUM = 0;
+
+/// Next counter a starting worker takes.
+static size_t SCHED_BENCH_WORKERS_STARTED = 0;
+
+/// Set once measuring is done, which sends the workers to sleep.
+static volatile bool SCHED_BENCH_DONE = false;
+
+/// Yields to whoever is next in line, counting how often.
+static void sched_bench_worker(void) {
+    const size_t idx = __atomic_fetch_add(&SCHED_BENCH_WORKERS_STARTED, 1, __ATOMIC_RELAXED);
+    while (!SCHED_BENCH_DONE) {
+        thread_yield();
+        SCHED_BENCH_COUNTERS[idx].yields++;
+    }
+    while (true) {
+        thread_sleep_ns(1000 * 1000 * 1000);
+    }
+}
+
+static uint64_t sched_bench_yields(void) {
+    uint64_t yields = 0;
+    for (size_t i = 0; i < SCHED_BENCH_WORKERS_NUM; i++) {
+        yields += SCHED_BENCH_COUNTERS[i].yields;
+    }
+    return yields;
+}
+
+/// Sleeps through the measurement, then reports what the workers managed.
+static void sched_bench_reporter(void) {
+    thread_sleep_ns(SCHED_BENCH_WARMUP_NS);
+    const uint64_t start_yields = sched_bench_yields();
+    const uint64_t start_ns = timer_now_ns();
+    thread_sleep_ns(SCHED_BENCH_DURATION_NS);
+    const uint64_t yields = sched_bench_yields() - start_yields;
+    const uint64_t ns = timer_now_ns() - start_ns;
+    SCHED_BENCH_DONE = true;
+
+    const size_t cpus = smp_cpu_count();
+    const uint64_t per_s = yields * 1000 / (ns / (1000 * 1000));
+    kprintf("%s: %lu CPUs, %lu threads: %lu yields per second, %lu per CPU\n", __func__, cpus, SCHED_BENCH_WORKERS_NUM,
+            per_s, per_s / cpus);
+    for (size_t i = 0; i < cpus; i++) {
+        kprintf("%s: CPU %lu stole %lu threads\n", __func__, i, thread_sched_priority_steals(i));
+    }
+    // Shows which locks kept the CPUs from scaling
+    lock_stats_dump();
+
+    while (true) {
+        thread_sleep_ns(1000 * 1000 * 1000);
+    }
+}
+
+void thread_sched_bench_start(void) {
+    SCHED_BENCH_WORKERS_NUM = smp_cpu_count() * SCHED_BENCH_THREADS_PER_CPU;
+    for (size_t i = 0; i < SCHED_BENCH_WORKERS_NUM; i++) {
+        thread_tid_t tid;
+        if (thread_create(sched_bench_worker, 0, &tid) != 0) {
+            kpanicf("%s: Failed to create worker threads\n", __func__);
+        }
+    }
+
+    // More urgent than the workers, so that it reports as soon as it wakes up
+    thread_tid_t reporter_tid;
+    if (thread_create(sched_bench_reporter, 0, &reporter_tid) != 0 ||
+        thread_set_priority(reporter_tid, THREAD_PRIORITY_DEFAULT - 1) != 0) {
+        kpanicf("%s: Failed to create reporter thread\n", __func__);
+    }
+}
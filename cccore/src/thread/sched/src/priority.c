@@ -0,0 +1,190 @@
+#include "../include/priority.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common.h"
+#include "../../include/thread.h"
+#include "../../src/internal.h"
+#include "../include/sched.h"
+#include "hal/include/timer.h"
+
+/// How long after it ran a thread's data is assumed to still be in the caches of it's CPU.
+///
+/// Thieves leave such threads alone unless there's nothing else to take.
+#define CACHE_HOT_NS (500 * 1000)
+
+/// How many threads of the victim's queue a thief looks at when searching for one whose caches went cold.
+#define STEAL_SCAN_MAX 8
+
+/// An intrusive FIFO of ready threads sharing the same priority.
+struct run_queue_t {
+    struct thread_t *head;
+    struct thread_t *tail;
+};
+
+/// Run queues of a single CPU.
+///
+/// Each CPU only schedules from it's own, and only touches those of others when it has nothing left to run.
+/// Aligned to a cache line, so that CPUs don't contend for each other's queues.
+struct cpu_run_queues_t {
+    /// Taken by the CPU itself for every switch, and by others only to steal from it or to queue a thread here.
+    struct ticketlock_t lock;
+    /// One run queue per priority level.
+    struct run_queue_t queues[THREAD_PRIORITY_NUM];
+    /// Bit `n` is set if and only if the run queue for priority `n` is non-empty.
+    ///
+    /// Lower priority values are more urgent, so the lowest set bit is the queue to pick from.
+    uint64_t nonempty;
+    /// Number of threads across all queues, which thieves compare to find the busiest CPU without taking locks.
+    size_t queued;
+    /// Number of threads this CPU has taken from others.
+    uint64_t steals;
+} __attribute__((aligned(64)));
+
+static struct cpu_run_queues_t CPU_RUN_QUEUES[SMP_CPUS_MAX];
+
+_Static_assert(THREAD_PRIORITY_NUM <= 64, "Run queue bitmap has too few bits for all priorities");
+
+void thread_sched_priority_init(void) {
+    for (size_t i = 0; i < SMP_CPUS_MAX; i++) {
+        ticketlock_init(&CPU_RUN_QUEUES[i].lock, "run_queues");
+    }
+}
+
+struct ticketlock_t *thread_sched_priority_lock(size_t cpu) { return &CPU_RUN_QUEUES[cpu].lock; }
+
+void thread_sched_priority_enqueue(struct thread_t *t) {
+    if (t->rq_queued) {
+        kpanicf("%s: Thread with TID %lu is already queued", __func__, t->tcb.tid);
+    }
+    struct cpu_run_queues_t *cpu = &CPU_RUN_QUEUES[t->rq_cpu];
+    struct run_queue_t *rq = &cpu->queues[t->tcb.priority];
+
+    t->rq_next = NULL;
+    t->rq_prev = rq->tail;
+    if (rq->tail != NULL) {
+        rq->tail->rq_next = t;
+    } else {
+        rq->head = t;
+    }
+    rq->tail = t;
+    t->rq_queued = true;
+
+    cpu->nonempty |= (uint64_t)1 << t->tcb.priority;
+    __atomic_store_n(&cpu->queued, cpu->queued + 1, __ATOMIC_RELAXED);
+}
+
+void thread_sched_priority_dequeue(struct thread_t *t) {
+    if (!t->rq_queued) {
+        return;
+    }
+    struct cpu_run_queues_t *cpu = &CPU_RUN_QUEUES[t->rq_cpu];
+    struct run_queue_t *rq = &cpu->queues[t->tcb.priority];
+
+    if (t->rq_prev != NULL) {
+        t->rq_prev->rq_next = t->rq_next;
+    } else {
+        rq->head = t->rq_next;
+    }
+    if (t->rq_next != NULL) {
+        t->rq_next->rq_prev = t->rq_prev;
+    } else {
+        rq->tail = t->rq_prev;
+    }
+    t->rq_next = NULL;
+    t->rq_prev = NULL;
+    t->rq_queued = false;
+
+    if (rq->head == NULL) {
+        cpu->nonempty &= ~((uint64_t)1 << t->tcb.priority);
+    }
+    __atomic_store_n(&cpu->queued, cpu->queued - 1, __ATOMIC_RELAXED);
+}
+
+bool thread_sched_priority_pending(void) { return CPU_RUN_QUEUES[smp_cpu()->id].nonempty != 0; }
+
+bool thread_sched_priority_stealable(void) {
+    const size_t self = smp_cpu()->id;
+    for (size_t i = 0; i < smp_cpu_count(); i++) {
+        if (i != self && __atomic_load_n(&CPU_RUN_QUEUES[i].queued, __ATOMIC_RELAXED) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t thread_sched_priority_steals(size_t cpu) { return CPU_RUN_QUEUES[cpu].steals; }
+
+/// Take a thread from the CPU with the most queued threads, for the calling CPU to run.
+///
+/// Among the victim's most urgent threads, the first one whose caches went cold is taken,
+/// so that threads which just ran there don't lose their warm caches for nothing.
+///
+/// The victim is found without taking any locks, and only it's lock is taken on top of the calling CPU's.
+/// If another CPU holds it, the thief doesn't wait while holding it's own lock, as the victim may be trying to steal
+/// from the thief in turn. The thief looks again the next time it reschedules.
+///
+/// Return NULL if no other CPU has threads waiting, or the victim's lock is taken.
+static struct thread_t *steal(void) {
+    const size_t self = smp_cpu()->id;
+    size_t victim = self;
+    size_t victim_queued = 0;
+    for (size_t i = 0; i < smp_cpu_count(); i++) {
+        const size_t queued = __atomic_load_n(&CPU_RUN_QUEUES[i].queued, __ATOMIC_RELAXED);
+        if (i != self && queued > victim_queued) {
+            victim = i;
+            victim_queued = queued;
+        }
+    }
+    if (victim_queued == 0 || !ticketlock_try_acquire(&CPU_RUN_QUEUES[victim].lock)) {
+        return NULL;
+    }
+    // It may have run out of threads meanwhile
+    if (CPU_RUN_QUEUES[victim].nonempty == 0) {
+        ticketlock_release(&CPU_RUN_QUEUES[victim].lock);
+        return NULL;
+    }
+
+    const unsigned int priority = (unsigned int)__builtin_ctzll(CPU_RUN_QUEUES[victim].nonempty);
+    struct thread_t *head = CPU_RUN_QUEUES[victim].queues[priority].head;
+    struct thread_t *stolen = head;
+    const uint64_t now_ns = timer_now_ns();
+    struct thread_t *t = head;
+    for (size_t i = 0; t != NULL && i < STEAL_SCAN_MAX; i++, t = t->rq_next) {
+        if (now_ns - t->rq_last_ran_ns >= CACHE_HOT_NS) {
+            stolen = t;
+            break;
+        }
+    }
+
+    // Moved while both locks are held, so whoever takes the lock of the thread's CPU afterwards sees the new one
+    thread_sched_priority_dequeue(stolen);
+    stolen->rq_cpu = self;
+    ticketlock_release(&CPU_RUN_QUEUES[victim].lock);
+    CPU_RUN_QUEUES[self].steals++;
+    return stolen;
+}
+
+thread_tid_t thread_sched_priority(void) {
+    // The active thread competes with the ready ones, queued behind those of equal priority.
+    // Idle threads never enter the queues, they're only picked when nothing else can run.
+    struct thread_t *active = lookup_thread_by_tid(THREADS_ACTIVE_TID);
+    if (active != NULL && THREADS_ACTIVE_TID != THREADS_IDLE_TID && active->tcb.state == THREAD_STATE_RUNNING &&
+        !active->rq_queued) {
+        thread_sched_priority_enqueue(active);
+    }
+
+    const struct cpu_run_queues_t *cpu = &CPU_RUN_QUEUES[smp_cpu()->id];
+    if (cpu->nonempty == 0) {
+        // Rather than going idle, help out a CPU that has more to do than it can run
+        struct thread_t *stolen = steal();
+        return stolen != NULL ? stolen->tcb.tid : THREADS_IDLE_TID;
+    }
+
+    // Find first set bit, AKA most urgent non-empty queue
+    const unsigned int priority = (unsigned int)__builtin_ctzll(cpu->nonempty);
+    struct thread_t *next = cpu->queues[priority].head;
+    thread_sched_priority_dequeue(next);
+    return next->tcb.tid;
+}
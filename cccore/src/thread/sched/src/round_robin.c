@@ -12,17 +12,19 @@ thread_tid_t thread_sched_round_robin(void) {
         kpanicf("%s: Could not locate TCB of currently active thread", __func__);
     }
 
-    // Walk all threads after active one
+    // Walk all threads after active one, skipping the idle threads of other CPUs
     for (size_t i = curr_thread_idx + 1; i < (THREADS_NUM - curr_thread_idx); i++) {
-        if (THREADS[i].tcb.state == THREAD_STATE_READY) {
-            return THREADS[i].tcb.tid;
+        if (THREADS[i].thread != NULL && THREADS[i].thread->tcb.state == THREAD_STATE_READY &&
+            THREADS[i].thread->tcb.priority != THREAD_PRIORITY_IDLE) {
+            return THREADS[i].thread->tcb.tid;
         }
     }
 
     // Walk all threads before active one
     for (size_t i = 0; i <= curr_thread_idx; i++) {
-        if (THREADS[i].tcb.state == THREAD_STATE_READY) {
-            return THREADS[i].tcb.tid;
+        if (THREADS[i].thread != NULL && THREADS[i].thread->tcb.state == THREAD_STATE_READY &&
+            THREADS[i].thread->tcb.priority != THREAD_PRIORITY_IDLE) {
+            return THREADS[i].thread->tcb.tid;
         }
     }
 
@@ -1,44 +1,175 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#include "../include/ipc.h"
+#include "../include/notification.h"
+#include "../include/sync.h"
 #include "../include/thread.h"
+#include "include/smp.h"
+#include "include/spinlock.h"
+#include "mem.h"
 
-/// TID of the idle thread.
-extern thread_tid_t THREADS_IDLE_TID;
+/// TID of the calling CPU's idle thread.
+#define THREADS_IDLE_TID (smp_cpu()->thread_idle_tid)
 
-/// TID of currently active thread.
+/// TID of the thread active on the calling CPU.
 ///
 /// Set to new value right before switch.
-extern thread_tid_t THREADS_ACTIVE_TID;
+#define THREADS_ACTIVE_TID (smp_cpu()->thread_active_tid)
 
-/// Number of threads we currently support
-#define THREADS_NUM 16
+/// Protects the table of threads, and everything threads block on other than sleeping.
+///
+/// Switching threads doesn't take it, that's up to the lock of each CPU's run queues.
+/// Whoever needs both takes this one first, and holds at most one run queue lock while waiting for another.
+extern struct ticketlock_t THREADS_LOCK;
+
+/// Disable interrupts and acquire `THREADS_LOCK`.
+///
+/// Return whether interrupts were enabled before, for `threads_unlock`.
+bool threads_lock(void);
+
+/// Release `THREADS_LOCK`, then enable interrupts again if they were enabled before `threads_lock`.
+void threads_unlock(bool interrupts_were_enabled);
+
+/// Disable interrupts and acquire the lock of the calling CPU's run queues.
+///
+/// A CPU switching threads holds it until it left the old thread's stack,
+/// so that no other CPU resumes the old thread on that same stack before then.
+///
+/// Return whether interrupts were enabled before, for `run_queue_unlock`.
+bool run_queue_lock(void);
+
+/// Release the lock of the calling CPU's run queues, then enable interrupts again if they were enabled before
+/// `run_queue_lock`.
+///
+/// Within an interrupt handler that switched threads, the lock is only released once the new thread is resumed.
+void run_queue_unlock(bool interrupts_were_enabled);
+
+/// Acquire the lock of the run queues of the CPU the thread last ran on, where it's queued when ready.
+///
+/// Once acquired, that CPU has left the thread's stack, and the thread stays on that CPU until the lock is released.
+/// Interrupts must be disabled, and the lock of no other run queues held.
+///
+/// Return the lock, for releasing it with `ticketlock_release`.
+struct ticketlock_t *run_queue_lock_of(struct thread_t *t);
+
+/// Number of threads we currently support.
+///
+/// Only the slot table is statically allocated, the threads themselves come from a slab cache.
+#define THREADS_NUM 1024
+
+/// Number of low TID bits which hold the index of the thread's slot in `THREADS`.
+///
+/// The remaining high bits hold the generation of the slot at the time the thread was created.
+/// This makes every lookup by TID a constant-time array access,
+/// while a stale TID never resolves to a newer thread that happens to reuse the slot.
+#define THREAD_TID_IDX_BITS 16
+
+/// Mask extracting the slot index from a TID.
+#define THREAD_TID_IDX_MASK ((((thread_tid_t)1) << THREAD_TID_IDX_BITS) - 1)
+
+_Static_assert(THREADS_NUM <= THREAD_TID_IDX_MASK + 1, "THREADS_NUM does not fit into the TID's index bits");
 
-/// Stack space allocated to each thread.
-/// Will be dynamic in future once proper memory management is implemented.
-#define THREAD_STACK_SIZE 4096
+/// How long a thread may run before it has to give way to other ready threads of the same priority.
+#define THREAD_TIME_SLICE_NS (10 * 1000 * 1000)
+
+/// How often idle CPUs look for threads waiting on busy CPUs to steal.
+///
+/// Busy CPUs steal as soon as they run out of threads anyway,
+/// and threads woken for idle CPUs come with a reschedule IPI.
+/// So this only catches the rest, and it's long enough for idle CPUs to stay asleep most of the time.
+#define THREAD_IDLE_BALANCE_NS (50 * 1000 * 1000)
+
+/// Base of the virtual area thread stacks are mapped into.
+#define THREAD_STACK_AREA_BASE 0xffffff0000000000
+
+/// Virtual space reserved for the stack of each slot in `THREADS`.
+///
+/// The stack is mapped at the top of the window, everything below it stays unmapped and acts as guard.
+#define THREAD_STACK_WINDOW_SIZE (THREAD_STACK_SIZE_MAX + MEM_PAGE_SIZE)
+
+/// What a thread is doing in IPC.
+enum thread_ipc_state_t {
+    /// Not involved in IPC.
+    THREAD_IPC_NONE,
+    /// Blocked until the partner receives it's message.
+    THREAD_IPC_SENDING,
+    /// Blocked until the partner receives it's message, then until the partner replies.
+    THREAD_IPC_CALLING,
+    /// Blocked until the partner, or anyone, sends a message.
+    THREAD_IPC_RECEIVING,
+};
 
 /// Data structure that owns everything related to a particular thread, for now.
 struct thread_t {
-    /// Whether the data structure is occupied or may be reused for a new thread.
-    bool occupied;
     /// TCB of this thread.
     struct thread_tcb_t tcb;
-    /// Memory for the thread's stack.
-    unsigned char stack[THREAD_STACK_SIZE];
+    /// Whether the thread is currently linked into the run queue of it's priority.
+    bool rq_queued;
+    /// Next thread in the run queue, if any.
+    struct thread_t *rq_next;
+    /// Previous thread in the run queue, if any.
+    struct thread_t *rq_prev;
+    /// CPU whose run queues the thread is in when ready, which is the CPU it last ran on unless it was moved.
+    ///
+    /// Only changed with the lock of the CPU the thread moves away from held, or with `THREADS_LOCK` held while the
+    /// thread is blocked.
+    size_t rq_cpu;
+    /// When the thread was last switched away from, to tell whether it's data is still in the caches of `rq_cpu`.
+    uint64_t rq_last_ran_ns;
+    /// When the thread should wake up, if it's sleeping.
+    uint64_t sleep_deadline_ns;
+    /// Next sleeping thread with an equal or later deadline, if any.
+    struct thread_t *sleep_next;
+    /// Size of the thread's stack, in bytes.
+    size_t stack_size;
+    /// What the thread is blocked on in IPC, if anything.
+    enum thread_ipc_state_t ipc_state;
+    /// Thread the thread is sending to or receiving from, may be `IPC_TID_ANY` when receiving.
+    thread_tid_t ipc_partner;
+    /// Message the thread is blocked sending.
+    struct ipc_msg_t ipc_msg;
+    /// First thread blocked sending to this thread, if any.
+    struct thread_t *ipc_senders_head;
+    /// Last thread blocked sending to this thread, if any.
+    struct thread_t *ipc_senders_tail;
+    /// Next thread blocked sending to the same thread, if any.
+    struct thread_t *ipc_senders_next;
+    /// Wait queue the thread is blocked in, if any.
+    struct wait_queue_t *wq_waiting_on;
+    /// Next thread blocked in the same wait queue, if any.
+    struct thread_t *wq_next;
+    /// Value handed to the thread by whoever woke it from a wait queue.
+    uint64_t wq_value;
+};
+
+/// Entry in the table of threads, which TIDs index into.
+struct thread_slot_t {
+    /// Thread occupying the slot, NULL if the slot may be reused for a new thread.
+    ///
+    /// Written with `THREADS_LOCK` held, and published with `rcu_assign_pointer` so it may be read without.
+    struct thread_t *thread;
+    /// Incremented whenever the slot is released, which invalidates the TIDs of all previous occupants.
+    uint64_t generation;
 };
 
-/// A statically-allocated pool of threads.
+/// A statically-allocated table of threads.
 ///
 /// Only functionality internal to the threading subsystem should ever access this.
-extern struct thread_t THREADS[THREADS_NUM];
+extern struct thread_slot_t THREADS[THREADS_NUM];
 
 /// Look up a thread based on it's TID.
 ///
 /// Return NULL if the TID does not belong to a currently alive thread.
 ///
 /// Reference lives at least until the thread terminates.
+/// Without `THREADS_LOCK` held, the thread's memory may be reclaimed once the caller's RCU read-side
+/// critical section ends, and the thread may be destroyed concurrently.
+///
+/// Runs in constant time, as the slot index is encoded in the TID.
 struct thread_t *lookup_thread_by_tid(thread_tid_t tid);
 
 /// Look up a thread's index in the thread array based on it's TID.
@@ -48,5 +179,110 @@ struct thread_t *lookup_thread_by_tid(thread_tid_t tid);
 /// Primarily of use for scheduling algorithms.
 int lookup_idx_by_tid(thread_tid_t tid, size_t *idx);
 
-/// Dump the given CPU state struct via kprintf.
-void print_cpu_state(const struct thread_cpu_state_t *const t_cpu);
+/// Construct the TID for the current occupant of the given slot in `THREADS`.
+thread_tid_t lookup_tid_by_idx(size_t idx);
+
+/// Map a stack of the given size into the window of the given slot.
+///
+/// Frames are taken from the physical memory manager, and not zeroed.
+///
+/// Return `-1` if not enough memory is available.
+///
+/// Return `0` on success.
+///
+/// The address right above the stack's highest byte is written into the outparam.
+int stack_map(size_t slot, size_t size, void **top);
+
+/// Unmap the stack of the given slot and return it's frames to the physical memory manager.
+void stack_unmap(size_t slot, size_t size);
+
+/// Report page faults in the unmapped part of a stack's window as stack overflow.
+///
+/// Registered as page fault hook.
+bool stack_guard_pf(uint64_t fault_addr, uint64_t err, struct interrupt_isr_data_t *data);
+
+/// Ask the scheduler which thread the calling CPU runs next.
+///
+/// The lock of the calling CPU's run queues must be held.
+struct thread_t *pick_next(void);
+
+/// Switch from the active thread to the given one outside of interrupt context.
+///
+/// Returns once the active thread is switched back to, possibly on another CPU, with interrupts still disabled
+/// but no run queue lock held.
+///
+/// The lock of the calling CPU's run queues must be held, it's released once the CPU runs the new thread.
+void switch_cooperative(struct thread_t *new_thread);
+
+/// Block the active thread and switch to whichever thread the scheduler picks next.
+///
+/// Returns once the thread has been woken and is switched back to, with `THREADS_LOCK` held again.
+///
+/// `THREADS_LOCK` must be held, and is released during the switch.
+void block(void);
+
+/// Make a blocked thread ready again.
+///
+/// The thread goes back to the CPU it last ran on if that CPU is idle, which a reschedule IPI tells about it.
+/// Otherwise, it goes to the calling CPU.
+/// If it's more urgent than the calling CPU's active thread, it preempts the active thread right away.
+/// This holds even when called from an interrupt handler, as the timer is made to expire immediately.
+///
+/// Does nothing if the thread is not blocked.
+///
+/// `THREADS_LOCK` must be held, but no run queue lock.
+void wake(struct thread_t *t);
+
+/// Fail the IPC of all threads blocked on the given one, as it's about to be destroyed.
+///
+/// `THREADS_LOCK` must be held.
+void ipc_thread_destroyed(struct thread_t *t);
+
+/// Block the active thread at the tail of the wait queue, until it's resumed.
+///
+/// Return the value passed to `wait_queue_resume`.
+///
+/// `THREADS_LOCK` must be held.
+uint64_t wait_queue_block(struct wait_queue_t *wq);
+
+/// Remove the longest-waiting thread from the wait queue, without waking it.
+///
+/// Return NULL if the queue is empty.
+///
+/// `THREADS_LOCK` must be held.
+struct thread_t *wait_queue_pop(struct wait_queue_t *wq);
+
+/// Append a thread that was popped from another wait queue, and is therefore still blocked.
+///
+/// `THREADS_LOCK` must be held.
+void wait_queue_push(struct wait_queue_t *wq, struct thread_t *t);
+
+/// Wake a thread popped from a wait queue, handing it the value.
+///
+/// `THREADS_LOCK` must be held.
+void wait_queue_resume(struct thread_t *t, uint64_t value);
+
+/// Remove the thread from the wait queue it's blocked in, if any, as it's about to be destroyed.
+///
+/// `THREADS_LOCK` must be held.
+void wait_queue_thread_destroyed(struct thread_t *t);
+
+/// Remember that the active thread's time slice starts now.
+///
+/// Return the time now.
+uint64_t tickless_slice_begin(void);
+
+/// Make the timer expire right away, so the scheduler gets to run a more urgent thread.
+///
+/// The lock of the calling CPU's run queues must be held.
+void tickless_preempt(void);
+
+/// Arm the timer for the next deadline, which is either a sleeping thread's wakeup or the end of the time slice.
+///
+/// The lock of the calling CPU's run queues must be held.
+void tickless_arm(void);
+
+/// Remove a thread from the list of sleeping threads, if it's in there.
+///
+/// The lock of the run queues of the CPU the thread last ran on must be held, see `run_queue_lock_of`.
+void tickless_sleepers_remove(struct thread_t *t);
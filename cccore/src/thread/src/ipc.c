@@ -0,0 +1,330 @@
+#include "../include/ipc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common.h"
+#include "../include/thread.h"
+#include "interrupt.h"
+#include "internal.h"
+#include "thread/sched/include/priority.h"
+#include "thread/sched/include/sched.h"
+
+//! Threads enter the kernel through `IPC_VECTOR`, with the registers holding:
+//!
+//! - `rax`: Operation in, status out (`0` on success, `-1` on failure)
+//! - `rdi`: Partner in, sender of the received message out
+//! - `rsi`, `rdx`, `rcx`, `r8`, `r9`, `r10`: Message words in and out
+//!
+//! The kernel reads the message straight from the sender's interrupt frame,
+//! and writes it straight into the frame the receiver resumes with.
+
+/// Operations, passed in `rax`.
+enum ipc_op_t {
+    IPC_OP_SEND,
+    IPC_OP_RECV,
+    IPC_OP_CALL,
+    IPC_OP_REPLY_RECV,
+};
+
+static const uint64_t IPC_STATUS_OK = 0;
+static const uint64_t IPC_STATUS_FAILED = UINT64_MAX;
+
+static void msg_from_frame(const struct interrupt_isr_data_t *frame, struct ipc_msg_t *msg) {
+    msg->words[0] = frame->rsi;
+    msg->words[1] = frame->rdx;
+    msg->words[2] = frame->rcx;
+    msg->words[3] = frame->r8;
+    msg->words[4] = frame->r9;
+    msg->words[5] = frame->r10;
+}
+
+/// Complete a receive, by placing the status, sender and message where the receiver expects them.
+static void msg_to_frame(struct interrupt_isr_data_t *frame, thread_tid_t sender, const struct ipc_msg_t *msg) {
+    frame->rax = IPC_STATUS_OK;
+    frame->rdi = sender;
+    frame->rsi = msg->words[0];
+    frame->rdx = msg->words[1];
+    frame->rcx = msg->words[2];
+    frame->r8 = msg->words[3];
+    frame->r9 = msg->words[4];
+    frame->r10 = msg->words[5];
+}
+
+/// Frame a thread blocked in IPC will resume with.
+static struct interrupt_isr_data_t *frame_of(struct thread_t *t) {
+    return (struct interrupt_isr_data_t *)t->tcb.stack_ptr;
+}
+
+/// Whether the thread is blocked receiving a message the sender may give it.
+static bool accepts(const struct thread_t *t, thread_tid_t sender) {
+    return t->ipc_state == THREAD_IPC_RECEIVING && (t->ipc_partner == IPC_TID_ANY || t->ipc_partner == sender);
+}
+
+static void senders_push(struct thread_t *receiver, struct thread_t *sender) {
+    sender->ipc_senders_next = NULL;
+    if (receiver->ipc_senders_tail != NULL) {
+        receiver->ipc_senders_tail->ipc_senders_next = sender;
+    } else {
+        receiver->ipc_senders_head = sender;
+    }
+    receiver->ipc_senders_tail = sender;
+}
+
+/// Remove the first sender with the given TID, or the first one if `IPC_TID_ANY` is given, from the queue.
+///
+/// Return NULL if there's no such sender.
+static struct thread_t *senders_take(struct thread_t *receiver, thread_tid_t src) {
+    struct thread_t *prev = NULL;
+    struct thread_t *sender = receiver->ipc_senders_head;
+    while (sender != NULL && src != IPC_TID_ANY && sender->tcb.tid != src) {
+        prev = sender;
+        sender = sender->ipc_senders_next;
+    }
+    if (sender == NULL) {
+        return NULL;
+    }
+
+    if (prev != NULL) {
+        prev->ipc_senders_next = sender->ipc_senders_next;
+    } else {
+        receiver->ipc_senders_head = sender->ipc_senders_next;
+    }
+    if (receiver->ipc_senders_tail == sender) {
+        receiver->ipc_senders_tail = prev;
+    }
+    sender->ipc_senders_next = NULL;
+    return sender;
+}
+
+/// Block the active thread and switch to whichever thread the scheduler picks.
+static void block_active(struct thread_t *self, struct interrupt_isr_data_t *frame) {
+    const bool interrupts_were_enabled = run_queue_lock();
+    self->tcb.state = THREAD_STATE_BLOCKED;
+    thread_switch_prepare(self->tcb.tid, thread_sched_priority(), frame);
+    tickless_arm();
+    run_queue_unlock(interrupts_were_enabled);
+}
+
+/// Switch from the active thread straight to a thread that was blocked in IPC, without asking the scheduler.
+static void switch_direct(struct thread_t *self, struct thread_t *to, struct interrupt_isr_data_t *frame) {
+    // The CPU the thread blocked on may still be switching away from it, and holds it's lock until it's done
+    ticketlock_release(run_queue_lock_of(to));
+
+    const bool interrupts_were_enabled = run_queue_lock();
+    // The scheduler would have queued the active thread itself, if it remains ready
+    if (self->tcb.state == THREAD_STATE_RUNNING) {
+        thread_sched_priority_enqueue(self);
+    }
+    thread_switch_prepare(self->tcb.tid, to->tcb.tid, frame);
+    tickless_arm();
+    run_queue_unlock(interrupts_were_enabled);
+}
+
+/// Hand the message of a sender taken from the queue to the active thread, which continues running.
+static void receive_from_queued(struct thread_t *self, struct thread_t *sender, struct interrupt_isr_data_t *frame) {
+    msg_to_frame(frame, sender->tcb.tid, &sender->ipc_msg);
+    if (sender->ipc_state == THREAD_IPC_CALLING) {
+        // Keeps blocking until the reply arrives
+        sender->ipc_state = THREAD_IPC_RECEIVING;
+        sender->ipc_partner = self->tcb.tid;
+    } else {
+        sender->ipc_state = THREAD_IPC_NONE;
+        frame_of(sender)->rax = IPC_STATUS_OK;
+        wake(sender);
+    }
+}
+
+static void send(struct thread_t *self, struct interrupt_isr_data_t *frame, bool call) {
+    struct thread_t *dest = lookup_thread_by_tid(frame->rdi);
+    if (dest == NULL || dest == self) {
+        frame->rax = IPC_STATUS_FAILED;
+        return;
+    }
+    struct ipc_msg_t msg;
+    msg_from_frame(frame, &msg);
+
+    // Fast path: The receiver is waiting already, so the message goes straight into it's frame
+    if (accepts(dest, self->tcb.tid)) {
+        msg_to_frame(frame_of(dest), self->tcb.tid, &msg);
+        dest->ipc_state = THREAD_IPC_NONE;
+        if (call) {
+            self->ipc_state = THREAD_IPC_RECEIVING;
+            self->ipc_partner = dest->tcb.tid;
+            self->tcb.state = THREAD_STATE_BLOCKED;
+        } else {
+            frame->rax = IPC_STATUS_OK;
+        }
+        switch_direct(self, dest, frame);
+        return;
+    }
+
+    // Slow path: Wait in line until the receiver asks for a message
+    self->ipc_msg = msg;
+    self->ipc_state = call ? THREAD_IPC_CALLING : THREAD_IPC_SENDING;
+    self->ipc_partner = dest->tcb.tid;
+    senders_push(dest, self);
+    block_active(self, frame);
+}
+
+static void recv(struct thread_t *self, struct interrupt_isr_data_t *frame, thread_tid_t src) {
+    if (src != IPC_TID_ANY && (src == self->tcb.tid || lookup_thread_by_tid(src) == NULL)) {
+        frame->rax = IPC_STATUS_FAILED;
+        return;
+    }
+
+    struct thread_t *sender = senders_take(self, src);
+    if (sender != NULL) {
+        receive_from_queued(self, sender, frame);
+        return;
+    }
+
+    self->ipc_state = THREAD_IPC_RECEIVING;
+    self->ipc_partner = src;
+    block_active(self, frame);
+}
+
+static void reply_recv(struct thread_t *self, struct interrupt_isr_data_t *frame) {
+    struct thread_t *dest = lookup_thread_by_tid(frame->rdi);
+    const bool replying = dest != NULL && dest != self && dest->ipc_state == THREAD_IPC_RECEIVING &&
+                          dest->ipc_partner == self->tcb.tid;
+    if (replying) {
+        struct ipc_msg_t msg;
+        msg_from_frame(frame, &msg);
+        msg_to_frame(frame_of(dest), self->tcb.tid, &msg);
+        dest->ipc_state = THREAD_IPC_NONE;
+    }
+
+    // With clients lining up already, the server keeps running and the client waits it's turn
+    struct thread_t *sender = senders_take(self, IPC_TID_ANY);
+    if (sender != NULL) {
+        if (replying) {
+            wake(dest);
+        }
+        receive_from_queued(self, sender, frame);
+        return;
+    }
+
+    // Fast path: Otherwise, the server waits for the next message, and the client continues right away
+    self->ipc_state = THREAD_IPC_RECEIVING;
+    self->ipc_partner = IPC_TID_ANY;
+    if (replying) {
+        self->tcb.state = THREAD_STATE_BLOCKED;
+        switch_direct(self, dest, frame);
+    } else {
+        block_active(self, frame);
+    }
+}
+
+static void ipc_isr(struct interrupt_isr_data_t *frame) {
+    const bool interrupts_were_enabled = threads_lock();
+    struct thread_t *self = lookup_thread_by_tid(THREADS_ACTIVE_TID);
+    // Idle threads must always be ready to run
+    if (self == NULL || THREADS_ACTIVE_TID == THREADS_IDLE_TID) {
+        frame->rax = IPC_STATUS_FAILED;
+        threads_unlock(interrupts_were_enabled);
+        return;
+    }
+
+    switch (frame->rax) {
+        case IPC_OP_SEND:
+            send(self, frame, false);
+            break;
+        case IPC_OP_RECV:
+            recv(self, frame, frame->rdi);
+            break;
+        case IPC_OP_CALL:
+            send(self, frame, true);
+            break;
+        case IPC_OP_REPLY_RECV:
+            reply_recv(self, frame);
+            break;
+        default:
+            frame->rax = IPC_STATUS_FAILED;
+            break;
+    }
+    threads_unlock(interrupts_were_enabled);
+}
+
+void ipc_init(void) { interrupt_register(ipc_isr, IPC_VECTOR); }
+
+/// Make a blocked thread's IPC fail.
+static void fail_blocked(struct thread_t *t) {
+    t->ipc_state = THREAD_IPC_NONE;
+    frame_of(t)->rax = IPC_STATUS_FAILED;
+    wake(t);
+}
+
+void ipc_thread_destroyed(struct thread_t *t) {
+    // Leave the queue of the thread it was sending to
+    if (t->ipc_state == THREAD_IPC_SENDING || t->ipc_state == THREAD_IPC_CALLING) {
+        struct thread_t *dest = lookup_thread_by_tid(t->ipc_partner);
+        if (dest != NULL) {
+            senders_take(dest, t->tcb.tid);
+        }
+    }
+    t->ipc_state = THREAD_IPC_NONE;
+
+    // Nobody's going to receive from it's queue anymore
+    struct thread_t *sender;
+    while ((sender = senders_take(t, IPC_TID_ANY)) != NULL) {
+        fail_blocked(sender);
+    }
+
+    // Nobody's going to send to those waiting for it, including callers waiting for a reply
+    for (size_t i = 0; i < THREADS_NUM; i++) {
+        struct thread_t *other = THREADS[i].thread;
+        if (other != NULL && other->ipc_state == THREAD_IPC_RECEIVING && other->ipc_partner == t->tcb.tid) {
+            fail_blocked(other);
+        }
+    }
+}
+
+/// Enter the kernel for IPC, see the register assignment above.
+static int ipc_syscall(enum ipc_op_t op, thread_tid_t partner, thread_tid_t *sender, struct ipc_msg_t *msg) {
+    register uint64_t rax __asm__("rax") = op;
+    register uint64_t rdi __asm__("rdi") = partner;
+    register uint64_t rsi __asm__("rsi") = msg->words[0];
+    register uint64_t rdx __asm__("rdx") = msg->words[1];
+    register uint64_t rcx __asm__("rcx") = msg->words[2];
+    register uint64_t r8 __asm__("r8") = msg->words[3];
+    register uint64_t r9 __asm__("r9") = msg->words[4];
+    register uint64_t r10 __asm__("r10") = msg->words[5];
+    __asm__ volatile(
+        ".intel_syntax noprefix \n\t"
+        "int %c[vector]         \n\t"
+        ".att_syntax prefix     \n\t"
+        : "+r"(rax), "+r"(rdi), "+r"(rsi), "+r"(rdx), "+r"(rcx), "+r"(r8), "+r"(r9), "+r"(r10)
+        : [vector] "i"(IPC_VECTOR)
+        : "memory");
+    if (rax != IPC_STATUS_OK) {
+        return -1;
+    }
+
+    if (sender != NULL) {
+        *sender = rdi;
+    }
+    msg->words[0] = rsi;
+    msg->words[1] = rdx;
+    msg->words[2] = rcx;
+    msg->words[3] = r8;
+    msg->words[4] = r9;
+    msg->words[5] = r10;
+    return 0;
+}
+
+int ipc_send(thread_tid_t dest, const struct ipc_msg_t *msg) {
+    struct ipc_msg_t copy = *msg;
+    return ipc_syscall(IPC_OP_SEND, dest, NULL, &copy);
+}
+
+int ipc_recv(thread_tid_t src, thread_tid_t *sender, struct ipc_msg_t *msg) {
+    return ipc_syscall(IPC_OP_RECV, src, sender, msg);
+}
+
+int ipc_call(thread_tid_t dest, struct ipc_msg_t *msg) { return ipc_syscall(IPC_OP_CALL, dest, NULL, msg); }
+
+int ipc_reply_recv(thread_tid_t dest, thread_tid_t *sender, struct ipc_msg_t *msg) {
+    return ipc_syscall(IPC_OP_REPLY_RECV, dest, sender, msg);
+}
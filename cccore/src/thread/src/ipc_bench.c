@@ -0,0 +1,75 @@
+#include <stdint.h>
+
+#include "../../common.h"
+#include "../include/ipc.h"
+#include "../include/thread.h"
+#include "hal/include/cpu.h"
+#include "hal/include/timer.h"
+
+/// Round trips that are measured.
+#define IPC_BENCH_ROUNDS 10000
+
+/// Round trips before measuring, so that caches and TLBs are warm.
+#define IPC_BENCH_WARMUP_ROUNDS 100
+
+static thread_tid_t IPC_BENCH_SERVER_TID = 0;
+
+/// Run by the client once it reported, if not NULL.
+static void (*IPC_BENCH_THEN)(void) = NULL;
+
+/// Replies to every message with the first word incremented.
+static void ipc_bench_server(void) {
+    thread_tid_t client;
+    struct ipc_msg_t msg;
+    if (ipc_recv(IPC_TID_ANY, &client, &msg) != 0) {
+        kpanicf("%s: Receiving failed\n", __func__);
+    }
+    while (true) {
+        msg.words[0]++;
+        if (ipc_reply_recv(client, &client, &msg) != 0) {
+            kpanicf("%s: Receiving failed\n", __func__);
+        }
+    }
+}
+
+static void ipc_bench_client(void) {
+    struct ipc_msg_t msg = {.words = {0}};
+    for (uint64_t i = 0; i < IPC_BENCH_WARMUP_ROUNDS; i++) {
+        if (ipc_call(IPC_BENCH_SERVER_TID, &msg) != 0) {
+            kpanicf("%s: Call failed\n", __func__);
+        }
+    }
+
+    const uint64_t start_ns = timer_now_ns();
+    const uint64_t start_cycles = cpu_rdtsc();
+    for (uint64_t i = 0; i < IPC_BENCH_ROUNDS; i++) {
+        if (ipc_call(IPC_BENCH_SERVER_TID, &msg) != 0) {
+            kpanicf("%s: Call failed\n", __func__);
+        }
+    }
+    const uint64_t cycles = cpu_rdtsc() - start_cycles;
+    const uint64_t ns = timer_now_ns() - start_ns;
+
+    if (msg.words[0] != IPC_BENCH_WARMUP_ROUNDS + IPC_BENCH_ROUNDS) {
+        kpanicf("%s: Server replied %lu times instead of %lu\n", __func__, msg.words[0],
+                IPC_BENCH_WARMUP_ROUNDS + IPC_BENCH_ROUNDS);
+    }
+    kprintf("%s: %lu round trips, %lu ns and %lu cycles each\n", __func__, (uint64_t)IPC_BENCH_ROUNDS,
+            ns / IPC_BENCH_ROUNDS, cycles / IPC_BENCH_ROUNDS);
+    if (IPC_BENCH_THEN != NULL) {
+        IPC_BENCH_THEN();
+    }
+
+    while (true) {
+        thread_sleep_ns(1000 * 1000 * 1000);
+    }
+}
+
+void ipc_bench_start(void (*then)(void)) {
+    IPC_BENCH_THEN = then;
+    thread_tid_t client_tid;
+    if (thread_create(ipc_bench_server, 0, &IPC_BENCH_SERVER_TID) != 0 ||
+        thread_create(ipc_bench_client, 0, &client_tid) != 0) {
+        kpanicf("%s: Failed to create benchmark threads\n", __func__);
+    }
+}
@@ -2,26 +2,32 @@
 
 #include "../../common.h"
 #include "../include/thread.h"
+#include "hal/include/rcu.h"
 #include "internal.h"
 #include "thread/src/tcb.h"
 
 struct thread_t* lookup_thread_by_tid(thread_tid_t tid) {
-    for (size_t i = 0; i < THREADS_NUM; i++) {
-        if (THREADS[i].tcb.tid == tid) {
-            return &THREADS[i];
-        }
+    const size_t i = (size_t)(tid & THREAD_TID_IDX_MASK);
+    if (i >= THREADS_NUM) {
+        return NULL;
+    }
+    // The slot may have been released or reused since the TID was handed out.
+    // Loaded only once, as it may be unpublished concurrently when `THREADS_LOCK` isn't held.
+    struct thread_t* t = rcu_dereference(THREADS[i].thread);
+    if (t == NULL || t->tcb.tid != tid) {
+        return NULL;
     }
 
-    return NULL;
+    return t;
 }
 
 int lookup_idx_by_tid(thread_tid_t tid, size_t* idx) {
-    for (size_t i = 0; i < THREADS_NUM; i++) {
-        if (THREADS[i].tcb.tid == tid) {
-            *idx = i;
-            return 0;
-        }
+    if (lookup_thread_by_tid(tid) == NULL) {
+        return -1;
     }
 
-    return -1;
+    *idx = (size_t)(tid & THREAD_TID_IDX_MASK);
+    return 0;
 }
+
+thread_tid_t lookup_tid_by_idx(size_t idx) { return (THREADS[idx].generation << THREAD_TID_IDX_BITS) | idx; }
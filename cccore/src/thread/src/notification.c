@@ -0,0 +1,100 @@
+#include "../include/notification.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common.h"
+#include "interrupt.h"
+#include "internal.h"
+
+/// Notification and bits bound to each interrupt.
+struct irq_binding_t {
+    struct notification_t *notification;
+    uint64_t bits;
+};
+
+/// One binding per IDT slot, unused ones have no notification.
+static struct irq_binding_t IRQ_BINDINGS[256] = {{NULL, 0}};
+
+void notification_init(struct notification_t *n) {
+    n->bits = 0;
+    wait_queue_init(&n->waiters);
+}
+
+void notification_signal(struct notification_t *n, uint64_t bits) {
+    if (bits == 0) {
+        return;
+    }
+    const bool interrupts_were_enabled = threads_lock();
+
+    struct thread_t *waiter = wait_queue_pop(&n->waiters);
+    if (waiter != NULL) {
+        // Hand the bits over directly, a waiter only blocks while none are pending
+        wait_queue_resume(waiter, bits);
+    } else {
+        n->bits |= bits;
+    }
+
+    threads_unlock(interrupts_were_enabled);
+}
+
+uint64_t notification_wait(struct notification_t *n) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    uint64_t bits = n->bits;
+    if (bits != 0) {
+        n->bits = 0;
+    } else {
+        bits = wait_queue_block(&n->waiters);
+    }
+
+    threads_unlock(interrupts_were_enabled);
+    return bits;
+}
+
+uint64_t notification_poll(struct notification_t *n) {
+    const bool interrupts_were_enabled = threads_lock();
+    const uint64_t bits = n->bits;
+    n->bits = 0;
+    threads_unlock(interrupts_were_enabled);
+    return bits;
+}
+
+/// Signal the notification bound to the interrupt, leaving everything else to the thread waiting on it.
+///
+/// The line stays masked until that thread acknowledges it. A level-triggered line is still raised until the device
+/// has been handled, so unmasking it any earlier would raise the interrupt again as soon as it's acknowledged here.
+static void irq_isr(struct interrupt_isr_data_t *data) {
+    const uint8_t idt_slot = (uint8_t)data->int_num;
+    interrupt_mask(idt_slot);
+    interrupt_ack(idt_slot);
+    const struct irq_binding_t *binding = &IRQ_BINDINGS[idt_slot];
+    if (binding->notification != NULL) {
+        notification_signal(binding->notification, binding->bits);
+    }
+}
+
+int notification_bind_irq(struct notification_t *n, uint64_t bits, uint8_t idt_slot) {
+    if (bits == 0) {
+        return -1;
+    }
+    const bool interrupts_were_enabled = threads_lock();
+    IRQ_BINDINGS[idt_slot].notification = n;
+    IRQ_BINDINGS[idt_slot].bits = bits;
+    interrupt_register(irq_isr, idt_slot);
+    threads_unlock(interrupts_were_enabled);
+    interrupt_unmask(idt_slot);
+    return 0;
+}
+
+int notification_ack_irq(uint8_t idt_slot) {
+    const bool interrupts_were_enabled = threads_lock();
+    const bool bound = IRQ_BINDINGS[idt_slot].notification != NULL;
+    threads_unlock(interrupts_were_enabled);
+    if (!bound) {
+        return -1;
+    }
+    interrupt_unmask(idt_slot);
+    return 0;
+}
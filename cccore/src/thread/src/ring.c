@@ -0,0 +1,188 @@
+#include "../include/ring.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../common.h"
+#include "interrupt.h"
+#include "internal.h"
+#include "kmalloc.h"
+#include "mem.h"
+#include "pmm.h"
+#include "vmm.h"
+
+struct ring_t {
+    /// Frame holding the control page.
+    uintptr_t shared_phys;
+    /// First frame of the physically contiguous data.
+    uintptr_t data_phys;
+    /// The data has `2^order` pages.
+    uint8_t order;
+    /// Size of the data, in bytes.
+    size_t size;
+    /// Only thread allowed to consume from the ring.
+    thread_tid_t consumer;
+    /// Whether the consumer is blocked in `ring_wait`, rather than on anything else.
+    bool consumer_blocked;
+};
+
+/// Number of frames in the ring, control page included.
+static size_t frames_num(const struct ring_t *ring) { return ((size_t)1 << ring->order) + 1; }
+
+/// Physical address of a frame of the ring, the control page being the first.
+static uintptr_t frame_phys(const struct ring_t *ring, size_t i) {
+    return i == 0 ? ring->shared_phys : ring->data_phys + (i - 1) * MEM_PAGE_SIZE;
+}
+
+int ring_create(uint8_t order, thread_tid_t consumer, struct ring_t **ring) {
+    struct ring_t *r = kmalloc(sizeof(struct ring_t));
+    if (r == NULL) {
+        return -1;
+    }
+    if (pmm_alloc(0, &r->shared_phys) != 0) {
+        kfree(r);
+        return -1;
+    }
+    if (pmm_alloc(order, &r->data_phys) != 0) {
+        pmm_free(r->shared_phys, 0);
+        kfree(r);
+        return -1;
+    }
+    // Mappings reference each frame on it's own
+    pmm_split(r->data_phys, order);
+
+    r->order = order;
+    r->size = (size_t)MEM_PAGE_SIZE << order;
+    r->consumer = consumer;
+    r->consumer_blocked = false;
+    struct ring_shared_t *shared = mem_phys_to_virt(r->shared_phys);
+    memset(shared, 0, MEM_PAGE_SIZE);
+    shared->size = r->size;
+
+    *ring = r;
+    return 0;
+}
+
+void ring_destroy(struct ring_t *ring) {
+    for (size_t i = 0; i < frames_num(ring); i++) {
+        pmm_unref(frame_phys(ring, i));
+    }
+    kfree(ring);
+}
+
+size_t ring_mapping_size(const struct ring_t *ring) { return frames_num(ring) * MEM_PAGE_SIZE; }
+
+int ring_map(struct ring_t *ring, uintptr_t virt, uint64_t flags, struct ring_view_t *view) {
+    // Anything beyond the canonical lower half would end up in the tables of the kernel's half,
+    // which every address space shares
+    if (virt % MEM_PAGE_SIZE != 0 || virt >= MEM_LOWER_HALF_END ||
+        MEM_LOWER_HALF_END - virt < ring_mapping_size(ring)) {
+        return -1;
+    }
+    for (size_t i = 0; i < frames_num(ring); i++) {
+        if (vmm_map(virt + i * MEM_PAGE_SIZE, frame_phys(ring, i), flags) != 0) {
+            ring_unmap(ring, virt);
+            return -1;
+        }
+        pmm_ref(frame_phys(ring, i));
+    }
+    view->shared = (struct ring_shared_t *)virt;
+    view->data = (uint8_t *)(virt + MEM_PAGE_SIZE);
+    return 0;
+}
+
+void ring_unmap(struct ring_t *ring, uintptr_t virt) {
+    for (size_t i = 0; i < frames_num(ring); i++) {
+        uintptr_t phys;
+        // Only drop references this ring's mapping holds, not those of whatever else is mapped there
+        if (vmm_translate(virt + i * MEM_PAGE_SIZE, &phys) != 0 || phys != frame_phys(ring, i)) {
+            continue;
+        }
+        vmm_unmap(virt + i * MEM_PAGE_SIZE, &phys);
+        pmm_unref(phys);
+    }
+}
+
+void ring_kernel_view(struct ring_t *ring, struct ring_view_t *view) {
+    view->shared = mem_phys_to_virt(ring->shared_phys);
+    view->data = mem_phys_to_virt(ring->data_phys);
+}
+
+size_t ring_write(struct ring_t *ring, const struct ring_view_t *view, const void *buf, size_t len) {
+    struct ring_shared_t *shared = view->shared;
+    const uint64_t size = shared->size;
+    const uint64_t tail = shared->tail;
+    const uint64_t head = __atomic_load_n(&shared->head, __ATOMIC_ACQUIRE);
+    const size_t n = len < size - (tail - head) ? len : size - (tail - head);
+
+    // The free space may wrap around the end of the data
+    const size_t pos = tail & (size - 1);
+    const size_t first = n < size - pos ? n : size - pos;
+    memcpy(view->data + pos, buf, first);
+    memcpy(view->data, (const uint8_t *)buf + first, n - first);
+    __atomic_store_n(&shared->tail, tail + n, __ATOMIC_RELEASE);
+
+    // Publishing the data has to be ordered before checking on the consumer, which does the opposite.
+    // Either the consumer sees the data before blocking, or we see it waiting.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (n > 0 && __atomic_load_n(&shared->head, __ATOMIC_RELAXED) == tail &&
+        __atomic_load_n(&shared->consumer_waiting, __ATOMIC_RELAXED) != 0) {
+        ring_doorbell(ring);
+    }
+    return n;
+}
+
+size_t ring_read(const struct ring_view_t *view, void *buf, size_t len) {
+    struct ring_shared_t *shared = view->shared;
+    const uint64_t size = shared->size;
+    const uint64_t head = shared->head;
+    const uint64_t tail = __atomic_load_n(&shared->tail, __ATOMIC_ACQUIRE);
+    const size_t n = len < tail - head ? len : tail - head;
+
+    const size_t pos = head & (size - 1);
+    const size_t first = n < size - pos ? n : size - pos;
+    memcpy(buf, view->data + pos, first);
+    memcpy((uint8_t *)buf + first, view->data, n - first);
+    __atomic_store_n(&shared->head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+void ring_wait(struct ring_t *ring, const struct ring_view_t *view) {
+    struct ring_shared_t *shared = view->shared;
+    const bool interrupts_were_enabled = threads_lock();
+
+    if (THREADS_ACTIVE_TID != ring->consumer) {
+        kpanicf("%s: Thread %lu is not the ring's consumer\n", __func__, THREADS_ACTIVE_TID);
+    }
+    while (true) {
+        // Pairs with the fence in `ring_write`
+        __atomic_store_n(&shared->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&shared->tail, __ATOMIC_SEQ_CST) != shared->head) {
+            break;
+        }
+        ring->consumer_blocked = true;
+        block();
+    }
+    __atomic_store_n(&shared->consumer_waiting, 0, __ATOMIC_RELAXED);
+
+    threads_unlock(interrupts_were_enabled);
+}
+
+void ring_doorbell(struct ring_t *ring) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    // Further writes don't need to ring again until the consumer is about to block anew
+    struct ring_shared_t *shared = mem_phys_to_virt(ring->shared_phys);
+    __atomic_store_n(&shared->consumer_waiting, 0, __ATOMIC_RELAXED);
+    if (ring->consumer_blocked) {
+        ring->consumer_blocked = false;
+        struct thread_t *consumer = lookup_thread_by_tid(ring->consumer);
+        if (consumer != NULL) {
+            wake(consumer);
+        }
+    }
+
+    threads_unlock(interrupts_were_enabled);
+}
@@ -0,0 +1,65 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common.h"
+#include "hal/include/rcu.h"
+#include "internal.h"
+#include "mem.h"
+#include "pmm.h"
+#include "vmm.h"
+
+_Static_assert(THREAD_STACK_SIZE_MAX % MEM_PAGE_SIZE == 0, "THREAD_STACK_SIZE_MAX is not a multiple of the page size");
+
+/// Start of the given slot's window.
+static uintptr_t window_base(size_t slot) { return THREAD_STACK_AREA_BASE + (slot * THREAD_STACK_WINDOW_SIZE); }
+
+int stack_map(size_t slot, size_t size, void **top) {
+    const uintptr_t window_top = window_base(slot) + THREAD_STACK_WINDOW_SIZE;
+    for (uintptr_t page = window_top - size; page < window_top; page += MEM_PAGE_SIZE) {
+        uintptr_t phys;
+        if (pmm_alloc(0, &phys) != 0) {
+            stack_unmap(slot, size);
+            return -1;
+        }
+        if (vmm_map(page, phys, VMM_FLAG_WRITABLE | VMM_FLAG_NO_EXECUTE) != 0) {
+            pmm_free(phys, 0);
+            stack_unmap(slot, size);
+            return -1;
+        }
+    }
+    *top = (void *)window_top;
+    return 0;
+}
+
+static void frame_release(uintptr_t phys, void *ctx) {
+    (void)ctx;
+    pmm_free(phys, 0);
+}
+
+void stack_unmap(size_t slot, size_t size) {
+    const uintptr_t window_top = window_base(slot) + THREAD_STACK_WINDOW_SIZE;
+    // Pages may be missing if mapping the stack failed halfway
+    vmm_unmap_range(window_top - size, size, frame_release, NULL);
+}
+
+bool stack_guard_pf(uint64_t fault_addr, uint64_t err, struct interrupt_isr_data_t *data) {
+    (void)err;
+    (void)data;
+    if (fault_addr < THREAD_STACK_AREA_BASE || fault_addr >= window_base(THREADS_NUM)) {
+        return false;
+    }
+
+    const size_t slot = (fault_addr - THREAD_STACK_AREA_BASE) / THREAD_STACK_WINDOW_SIZE;
+    // Page faults run with interrupts disabled, which makes the handler a read-side critical section
+    const struct thread_t *t = rcu_dereference(THREADS[slot].thread);
+    if (t == NULL) {
+        kpanicf("%s: Access to %p in the stack window of unoccupied slot %lu\n", __func__, fault_addr, slot);
+    }
+    if (fault_addr < window_base(slot) + THREAD_STACK_WINDOW_SIZE - t->stack_size) {
+        kpanicf("%s: Stack overflow in thread with TID %lu, accessed %p below it's %lu byte stack\n", __func__,
+                t->tcb.tid, fault_addr, t->stack_size);
+    }
+    // Within the mapped stack, so something else is wrong
+    return false;
+}
@@ -1,24 +1,44 @@
 .intel_syntax noprefix
 
+.extern isr_common_return
+
+//; Enter a thread by resuming the interrupt frame it's stack pointer points to.
+//; Only needed when not already inside an ISR, which resumes frames on it's own.
 .global thread_switch_asm
 thread_switch_asm:
-	mov rsp, rdi //; First arg is pointer to saved CPU data
-	pop r15
-	pop r14
-	pop r13
-	pop r12
-	pop r11
-	pop r10
-	pop r9
-	pop r8
-	pop rbp
-	pop rdi //; Ignore stack pointer by popping to junk reg for now
-	pop rdi
-	pop rsi
-	pop rdx
-	pop rcx
-	pop rbx
-	pop rax
+	mov rsp, rdi //; First arg is pointer to the saved frame
+	//; Pops all registers, followed by RIP, CS, RFLAGS, RSP and SS via iretq - and we're off
+	jmp isr_common_return
+
+//; Switch away from the calling thread outside of interrupt context.
+//; First arg is where to store the calling thread's frame pointer, second arg is the frame to resume.
+//;
+//; The caller's state is stored as an interrupt frame that resumes right after the call,
+//; so that it can be resumed just like a preempted thread, via iretq.
+//; Only callee-saved registers are actually saved, as the caller doesn't expect the others to survive the call anyway.
+//; Interrupts must be disabled.
+.global thread_switch_cooperative_asm
+thread_switch_cooperative_asm:
+	pop rax //; Return address, which is where the thread resumes
+	mov rdx, rsp //; Stack pointer as the caller expects it after returning
+	mov ecx, ss
+	push rcx
+	push rdx
+	pushfq
+	mov ecx, cs
+	push rcx
+	push rax
+	sub rsp, 2*8 //; Argument and ISR number are meaningless here
+	push r15
+	push r14
+	push r13
+	push r12
+	sub rsp, 4*8 //; r11, r10, r9, r8
+	push rbp
+	sub rsp, 4*8 //; rdi, rsi, rdx, rcx
+	push rbx
+	sub rsp, 1*8 //; rax
 
-	//; retq pops the rip from the stack and jumps there
-	retq //; and we're off
\ No newline at end of file
+	mov [rdi], rsp
+	mov rsp, rsi
+	jmp isr_common_return
@@ -0,0 +1,238 @@
+#include "../include/sync.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common.h"
+#include "interrupt.h"
+#include "internal.h"
+
+void wait_queue_init(struct wait_queue_t *wq) {
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+void wait_queue_push(struct wait_queue_t *wq, struct thread_t *t) {
+    t->wq_waiting_on = wq;
+    t->wq_next = NULL;
+    if (wq->tail != NULL) {
+        wq->tail->wq_next = t;
+    } else {
+        wq->head = t;
+    }
+    wq->tail = t;
+}
+
+struct thread_t *wait_queue_pop(struct wait_queue_t *wq) {
+    struct thread_t *t = wq->head;
+    if (t == NULL) {
+        return NULL;
+    }
+    wq->head = t->wq_next;
+    if (wq->head == NULL) {
+        wq->tail = NULL;
+    }
+    t->wq_waiting_on = NULL;
+    t->wq_next = NULL;
+    return t;
+}
+
+uint64_t wait_queue_block(struct wait_queue_t *wq) {
+    struct thread_t *active = lookup_thread_by_tid(THREADS_ACTIVE_TID);
+    if (active == NULL || THREADS_ACTIVE_TID == THREADS_IDLE_TID) {
+        kpanicf("%s: Only threads other than idle threads may wait", __func__);
+    }
+    wait_queue_push(wq, active);
+    block();
+
+    const uint64_t value = active->wq_value;
+    active->wq_value = 0;
+    return value;
+}
+
+void wait_queue_resume(struct thread_t *t, uint64_t value) {
+    t->wq_value = value;
+    wake(t);
+}
+
+void wait_queue_thread_destroyed(struct thread_t *t) {
+    struct wait_queue_t *wq = t->wq_waiting_on;
+    if (wq == NULL) {
+        return;
+    }
+    struct thread_t *prev = NULL;
+    for (struct thread_t *waiter = wq->head; waiter != NULL; waiter = waiter->wq_next) {
+        if (waiter == t) {
+            if (prev != NULL) {
+                prev->wq_next = t->wq_next;
+            } else {
+                wq->head = t->wq_next;
+            }
+            if (wq->tail == t) {
+                wq->tail = prev;
+            }
+            break;
+        }
+        prev = waiter;
+    }
+    t->wq_waiting_on = NULL;
+    t->wq_next = NULL;
+}
+
+void mutex_init(struct mutex_t *m) {
+    m->locked = false;
+    m->owner = 0;
+    wait_queue_init(&m->waiters);
+}
+
+/// Hand the mutex to a thread that's blocked waiting for it, or queue it up if someone else owns the mutex.
+///
+/// `THREADS_LOCK` must be held.
+static void mutex_give(struct mutex_t *m, struct thread_t *t) {
+    if (m->locked) {
+        wait_queue_push(&m->waiters, t);
+        return;
+    }
+    m->locked = true;
+    m->owner = t->tcb.tid;
+    wait_queue_resume(t, 0);
+}
+
+/// Unlock the mutex owned by the active thread, handing it to the longest waiter.
+///
+/// `THREADS_LOCK` must be held.
+static void mutex_release(struct mutex_t *m, const char *caller) {
+    if (!m->locked || m->owner != THREADS_ACTIVE_TID) {
+        kpanicf("%s: Thread %lu doesn't own the mutex\n", caller, THREADS_ACTIVE_TID);
+    }
+    struct thread_t *next = wait_queue_pop(&m->waiters);
+    if (next == NULL) {
+        m->locked = false;
+        return;
+    }
+    // The mutex stays locked, so nobody can take it before the waiter gets to run
+    m->owner = next->tcb.tid;
+    wait_queue_resume(next, 0);
+}
+
+void mutex_lock(struct mutex_t *m) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    if (!m->locked) {
+        m->locked = true;
+        m->owner = THREADS_ACTIVE_TID;
+    } else {
+        if (m->owner == THREADS_ACTIVE_TID) {
+            kpanicf("%s: Thread %lu owns the mutex already\n", __func__, THREADS_ACTIVE_TID);
+        }
+        // Whoever wakes us hands over the mutex
+        wait_queue_block(&m->waiters);
+    }
+
+    threads_unlock(interrupts_were_enabled);
+}
+
+bool mutex_trylock(struct mutex_t *m) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    const bool locked = !m->locked;
+    if (locked) {
+        m->locked = true;
+        m->owner = THREADS_ACTIVE_TID;
+    }
+
+    threads_unlock(interrupts_were_enabled);
+    return locked;
+}
+
+void mutex_unlock(struct mutex_t *m) {
+    const bool interrupts_were_enabled = threads_lock();
+    mutex_release(m, __func__);
+    threads_unlock(interrupts_were_enabled);
+}
+
+void semaphore_init(struct semaphore_t *s, uint64_t count) {
+    s->count = count;
+    wait_queue_init(&s->waiters);
+}
+
+void semaphore_down(struct semaphore_t *s) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    if (s->count > 0) {
+        s->count--;
+    } else {
+        // Whoever wakes us hands over what they released, without raising the count
+        wait_queue_block(&s->waiters);
+    }
+
+    threads_unlock(interrupts_were_enabled);
+}
+
+bool semaphore_trydown(struct semaphore_t *s) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    const bool taken = s->count > 0;
+    if (taken) {
+        s->count--;
+    }
+
+    threads_unlock(interrupts_were_enabled);
+    return taken;
+}
+
+void semaphore_up(struct semaphore_t *s) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    struct thread_t *next = wait_queue_pop(&s->waiters);
+    if (next != NULL) {
+        wait_queue_resume(next, 0);
+    } else {
+        s->count++;
+    }
+
+    threads_unlock(interrupts_were_enabled);
+}
+
+void condvar_init(struct condvar_t *cv) {
+    wait_queue_init(&cv->waiters);
+    cv->mutex = NULL;
+}
+
+void condvar_wait(struct condvar_t *cv, struct mutex_t *m) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    if (cv->waiters.head != NULL && cv->mutex != m) {
+        kpanicf("%s: Waiters of the condition variable use different mutexes\n", __func__);
+    }
+    cv->mutex = m;
+    // Releasing and starting to wait happen at once, so no signal can get lost in between
+    mutex_release(m, __func__);
+    // Whoever wakes us hands over the mutex
+    wait_queue_block(&cv->waiters);
+
+    threads_unlock(interrupts_were_enabled);
+}
+
+void condvar_signal(struct condvar_t *cv) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    struct thread_t *t = wait_queue_pop(&cv->waiters);
+    if (t != NULL) {
+        mutex_give(cv->mutex, t);
+    }
+
+    threads_unlock(interrupts_were_enabled);
+}
+
+void condvar_broadcast(struct condvar_t *cv) {
+    const bool interrupts_were_enabled = threads_lock();
+
+    struct thread_t *t;
+    while ((t = wait_queue_pop(&cv->waiters)) != NULL) {
+        mutex_give(cv->mutex, t);
+    }
+
+    threads_unlock(interrupts_were_enabled);
+}
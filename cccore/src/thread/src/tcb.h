@@ -4,6 +4,23 @@
 
 typedef uint64_t thread_tid_t;
 
+/// Scheduling priority of a thread.
+///
+/// Lower values are more urgent.
+typedef uint8_t thread_priority_t;
+
+/// Number of distinct thread priorities.
+#define THREAD_PRIORITY_NUM 64
+
+/// The most urgent priority.
+#define THREAD_PRIORITY_HIGHEST 0
+
+/// The least urgent priority, which only the idle thread may use.
+#define THREAD_PRIORITY_IDLE (THREAD_PRIORITY_NUM - 1)
+
+/// Priority given to newly created threads.
+#define THREAD_PRIORITY_DEFAULT (THREAD_PRIORITY_NUM / 2)
+
 enum thread_state_t {
     THREAD_STATE_RUNNING,
     THREAD_STATE_READY,
@@ -14,35 +31,8 @@ void kprintf_thread_state_t(enum thread_state_t state);
 
 struct thread_tcb_t {
     thread_tid_t tid;
+    /// While the thread is not running, points to the interrupt frame it was suspended with.
     void *stack_ptr;
     enum thread_state_t state;
-};
-
-typedef uint64_t thread_register_t;
-
-/// Data structure holding the thread's CPU state.
-///
-/// NOTE: This is used by ASM code!
-/// Never change anything about this struct without also adjusting that code.
-struct __attribute__((packed)) thread_cpu_state_t {
-    thread_register_t r15;
-    thread_register_t r14;
-    thread_register_t r13;
-    thread_register_t r12;
-    thread_register_t r11;
-    thread_register_t r10;
-    thread_register_t r9;
-    thread_register_t r8;
-
-    thread_register_t rbp;
-    thread_register_t rsp;
-    thread_register_t rdi;
-    thread_register_t rsi;
-    thread_register_t rdx;
-    thread_register_t rcx;
-    thread_register_t rbx;
-    thread_register_t rax;
-
-    thread_register_t
-        rip;  // Must be down here because it's the last thing popped on thread switch via retq instruction.
+    thread_priority_t priority;
 };
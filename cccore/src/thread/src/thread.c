@@ -2,237 +2,487 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "../../common.h"
+#include "exception.h"
+#include "gdt.h"
+#include "hal/include/ipi.h"
+#include "hal/include/rcu.h"
 #include "internal.h"
 #include "interrupt.h"
+#include "slab.h"
 #include "tcb.h"
+#include "thread/sched/include/priority.h"
+#include "thread/sched/include/sched.h"
 #include "thread/src/tcb.h"
 
-struct thread_t THREADS[THREADS_NUM];
+struct thread_slot_t THREADS[THREADS_NUM];
 
-/// TID generator state.
-static thread_tid_t THREADS_NEXT_TID = 0;
+/// Cache the threads are allocated from.
+static struct slab_cache_t THREADS_CACHE;
 
-/// Currently active thread.
-thread_tid_t THREADS_ACTIVE_TID = 0;
+/// Stack of unoccupied slots in `THREADS`, so finding one doesn't require a search.
+static size_t FREE_SLOTS[THREADS_NUM];
 
-/// TID of the idle thread
-thread_tid_t THREADS_IDLE_TID = 0;
+/// Number of entries in `FREE_SLOTS`.
+static size_t FREE_SLOTS_NUM = 0;
 
-/// Find the first unoccupied thread slot.
+struct ticketlock_t THREADS_LOCK = TICKETLOCK_INIT("threads");
+
+bool threads_lock(void) { return ticketlock_acquire_irqsave(&THREADS_LOCK); }
+
+void threads_unlock(bool interrupts_were_enabled) {
+    ticketlock_release_irqrestore(&THREADS_LOCK, interrupts_were_enabled);
+}
+
+bool run_queue_lock(void) {
+    // Otherwise, the thread may be migrated between finding the CPU and taking it's lock
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    ticketlock_acquire(thread_sched_priority_lock(smp_cpu()->id));
+    return interrupts_were_enabled;
+}
+
+void run_queue_unlock(bool interrupts_were_enabled) {
+    struct ticketlock_t* lock = thread_sched_priority_lock(smp_cpu()->id);
+    // A pending switch releases the lock on it's own, once the CPU is on the new thread's stack.
+    // The interrupt flag is part of the frame that's resumed, so there's nothing to restore either.
+    if (smp_cpu()->int_resume_unlock == lock) {
+        return;
+    }
+    ticketlock_release_irqrestore(lock, interrupts_were_enabled);
+}
+
+struct ticketlock_t* run_queue_lock_of(struct thread_t* t) {
+    while (true) {
+        struct ticketlock_t* lock = thread_sched_priority_lock(__atomic_load_n(&t->rq_cpu, __ATOMIC_RELAXED));
+        ticketlock_acquire(lock);
+        // Another CPU may have stolen the thread while we waited
+        if (lock == thread_sched_priority_lock(t->rq_cpu)) {
+            return lock;
+        }
+        ticketlock_release(lock);
+    }
+}
+
+/// Take an unoccupied thread slot.
 ///
-/// If none are found, return `-1`.
+/// If none are left, return `-1`.
 ///
 /// Return `0` on success.
 static int find_free_slot(size_t* slot) {
-    for (size_t i = 0; i < THREADS_NUM; i++) {
-        if (!THREADS[i].occupied) {
-            *slot = i;
-            return 0;
-        }
+    if (FREE_SLOTS_NUM == 0) {
+        return -1;
+    }
+    FREE_SLOTS_NUM--;
+    *slot = FREE_SLOTS[FREE_SLOTS_NUM];
+    return 0;
+}
+
+/// Give back a slot taken by `find_free_slot`.
+static void release_slot(size_t slot) {
+    THREADS[slot].thread = NULL;
+    // Invalidate the TID, so it doesn't resolve to whatever thread reuses the slot next
+    THREADS[slot].generation++;
+    FREE_SLOTS[FREE_SLOTS_NUM] = slot;
+    FREE_SLOTS_NUM++;
+}
+
+/// RFLAGS a thread starts out with: Only the always-set reserved bit and IF, so the thread can be preempted.
+static const uint64_t INITIAL_RFLAGS = 0x202;
+
+/// Where threads end up if their entrypoint function returns.
+static void __attribute__((noreturn)) entry_returned(void) {
+    kpanicf("%s: Thread with TID %lu returned from it's entrypoint", __func__, THREADS_ACTIVE_TID);
+}
+
+/// Place an interrupt frame on top of the thread's stack, so that resuming it enters the thread at `pc`.
+///
+/// This way, threads are entered the same way as they're resumed after being preempted.
+static void prepare_stack(uint64_t pc, struct thread_t* t) {
+    unsigned char* stack_top = (unsigned char*)t->tcb.stack_ptr;
+
+    // Fake return address, as if the entrypoint had been called.
+    // This also gives the thread the stack alignment the ABI expects on function entry.
+    uint64_t* ret_addr = (uint64_t*)(stack_top - sizeof(uint64_t));
+    *ret_addr = (uint64_t)entry_returned;
+
+    struct interrupt_isr_data_t* frame =
+        (struct interrupt_isr_data_t*)((unsigned char*)ret_addr - sizeof(struct interrupt_isr_data_t));
+    memset(frame, 0, sizeof(struct interrupt_isr_data_t));
+    frame->rip = pc;
+    frame->cs = GDT_CODE_IDX;
+    frame->rflags = INITIAL_RFLAGS;
+    frame->rsp = (uint64_t)ret_addr;
+    frame->ss = 0;
+    // rbp is zeroed to terminate stack traces
+
+    t->tcb.stack_ptr = frame;
+}
+
+/// Create a new thread without making it eligible for scheduling.
+static int create_thread(thread_entrypoint_t entry, thread_priority_t priority, size_t stack_size,
+                         thread_tid_t* tid) {
+    if (stack_size == 0) {
+        stack_size = THREAD_STACK_SIZE_DEFAULT;
     }
+    if (stack_size > THREAD_STACK_SIZE_MAX) {
+        return -1;
+    }
+    stack_size = (stack_size + MEM_PAGE_SIZE - 1) & ~((size_t)MEM_PAGE_SIZE - 1);
 
-    return -1;
-}
-
-/// Save the thread's CPU state to the thread's stack and TCB.
-static void save_cpu_state(struct thread_cpu_state_t cpu, struct thread_t* t) {
-    unsigned char* dest = (unsigned char*)(t->tcb.stack_ptr) - sizeof(struct thread_cpu_state_t);
-    memcpy(dest, &cpu, sizeof(struct thread_cpu_state_t));
-    t->tcb.stack_ptr = dest;
-}
-
-static void prepare_stack(thread_register_t pc, thread_register_t sp, struct thread_t* t) {
-    const struct thread_cpu_state_t cpu = {
-        .rip = pc,
-        .rax = 1,
-        .rbx = 2,
-        .rcx = 3,
-        .rdx = 4,
-        .rsi = 5,
-        .rdi = 6,
-        .rsp = sp,
-        .rbp = sp,  // FIXME: This causes thread to do weird things when it has no more instructions
-        .r8 = 7,
-        .r9 = 8,
-        .r10 = 9,
-        .r11 = 10,
-        .r12 = 11,
-        .r13 = 12,
-        .r14 = 13,
-        .r15 = 14,
-    };
-    save_cpu_state(cpu, t);
-}
-
-int thread_create(thread_entrypoint_t entry, thread_tid_t* tid) {
     // Which slot is free, if any?
     size_t slot;
-    if (find_free_slot(&slot) != 0) {
+    bool interrupts_were_enabled = threads_lock();
+    const int found = find_free_slot(&slot);
+    threads_unlock(interrupts_were_enabled);
+    if (found != 0) {
+        return -1;
+    }
+    struct thread_t* t = slab_alloc(&THREADS_CACHE);
+    // Stacks aren't zeroed, threads don't get to rely on their contents anyways
+    void* stack_top;
+    if (t == NULL || stack_map(slot, stack_size, &stack_top) != 0) {
+        if (t != NULL) {
+            slab_free(&THREADS_CACHE, t);
+        }
+        interrupts_were_enabled = threads_lock();
+        release_slot(slot);
+        threads_unlock(interrupts_were_enabled);
         return -1;
     }
-    struct thread_t* t = &THREADS[slot];
 
-    // Allocate a TID.
-    // For now, just increment a global counter.
-    *tid = THREADS_NEXT_TID;
-    THREADS_NEXT_TID++;
+    // The TID encodes the slot, so that lookups don't have to search for it.
+    *tid = lookup_tid_by_idx(slot);
 
     // Prepare data structures
-    t->occupied = true;
-    memset(t->stack, 0, THREAD_STACK_SIZE);
     const struct thread_tcb_t tcb = {
-        .stack_ptr = t->stack + THREAD_STACK_SIZE, .state = THREAD_STATE_BLOCKED, .tid = *tid};
+        .stack_ptr = stack_top, .state = THREAD_STATE_BLOCKED, .tid = *tid, .priority = priority};
     t->tcb = tcb;
+    t->stack_size = stack_size;
+    t->rq_queued = false;
+    t->rq_next = NULL;
+    t->rq_prev = NULL;
+    // Starts out on the creator's CPU, with nothing in the caches worth staying for
+    t->rq_cpu = smp_cpu()->id;
+    t->rq_last_ran_ns = 0;
+    t->sleep_deadline_ns = 0;
+    t->sleep_next = NULL;
+    t->ipc_state = THREAD_IPC_NONE;
+    t->ipc_partner = 0;
+    t->ipc_senders_head = NULL;
+    t->ipc_senders_tail = NULL;
+    t->ipc_senders_next = NULL;
+    t->wq_waiting_on = NULL;
+    t->wq_next = NULL;
+    t->wq_value = 0;
 
     // Make it look to the thread like it's returning after a context switch to eliminate special cases.
-    const thread_register_t pc =
-        (thread_register_t)entry;  // TODO: Change once user address space != kernel address space
-    const thread_register_t sp = (thread_register_t)t->stack +
-                                 THREAD_STACK_SIZE;  // TODO: Change once user address space != kernel address space
-    prepare_stack(pc, sp, t);
+    const uint64_t pc = (uint64_t)entry;  // TODO: Change once user address space != kernel address space
+    prepare_stack(pc, t);
     t->tcb.state = THREAD_STATE_READY;
+
+    // Only published once it's fully set up, as other CPUs may look it up right away
+    interrupts_were_enabled = threads_lock();
+    rcu_assign_pointer(THREADS[slot].thread, t);
+    threads_unlock(interrupts_were_enabled);
     return 0;
 }
 
+int thread_create(thread_entrypoint_t entry, size_t stack_size, thread_tid_t* tid) {
+    if (create_thread(entry, THREAD_PRIORITY_DEFAULT, stack_size, tid) != 0) {
+        return -1;
+    }
+    struct thread_t* t = lookup_thread_by_tid(*tid);
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    struct ticketlock_t* lock = run_queue_lock_of(t);
+    thread_sched_priority_enqueue(t);
+    ticketlock_release(lock);
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+    return 0;
+}
+
+/// Runs whenever no other thread is ready.
+///
+/// Whoever switched here has already armed the timer for the next deadline, if there is one.
+/// Until then, or until some other interrupt makes a thread ready, the CPU may as well sleep.
 static void idle_thread(void) {
     while (true) {
-        kprintf("Hello from the idle thread!\n");
+        __asm__ volatile("hlt");
     }
 }
 
 void thread_threading_init(void) {
-    // Clear data structures
+    // Clear data structures, lower slots are handed out first
     for (size_t i = 0; i < THREADS_NUM; i++) {
-        THREADS[i].occupied = false;
-        THREADS[i].tcb = (struct thread_tcb_t){
-            .tid = 0,
-            .stack_ptr = NULL,
-            .state = THREAD_STATE_DEAD,
-        };
-        memset(THREADS[i].stack, 0, THREAD_STACK_SIZE);
+        THREADS[i].thread = NULL;
+        THREADS[i].generation = 0;
+        FREE_SLOTS[i] = THREADS_NUM - 1 - i;
     }
+    FREE_SLOTS_NUM = THREADS_NUM;
+    thread_sched_priority_init();
+    slab_cache_init(&THREADS_CACHE, "thread_t", sizeof(struct thread_t));
+    exception_pf_hook_register(stack_guard_pf);
 
-    // Create the idle thread
-    thread_tid_t idle_tid;
-    thread_create(idle_thread, &idle_tid);
+    // Create an idle thread for each CPU.
+    // They're not queued, as the scheduler of each CPU falls back to it's own when nothing else is ready.
+    for (size_t i = 0; i < smp_cpu_count(); i++) {
+        thread_tid_t idle_tid;
+        if (create_thread(idle_thread, THREAD_PRIORITY_IDLE, THREAD_STACK_SIZE_DEFAULT, &idle_tid) != 0) {
+            kpanicf("%s: Failed to create idle thread for CPU %lu", __func__, i);
+        }
+        SMP_CPUS[i].thread_idle_tid = idle_tid;
+    }
 }
 
-struct thread_tcb_t* thread_lookup_tcb_by_tid(thread_tid_t tid) {
-    for (size_t i = 0; i < THREADS_NUM; i++) {
-        if (THREADS[i].tcb.tid == tid) {
-            return &THREADS[i].tcb;
-        }
+int thread_destroy(thread_tid_t tid) {
+    bool interrupts_were_enabled = threads_lock();
+    struct thread_t* t = lookup_thread_by_tid(tid);
+    if (t == NULL || t->tcb.priority == THREAD_PRIORITY_IDLE) {
+        threads_unlock(interrupts_were_enabled);
+        return -1;
     }
+    // A running thread's stack is in use by some CPU, whether it's the calling thread or one on another CPU
+    struct ticketlock_t* lock = run_queue_lock_of(t);
+    if (t->tcb.state == THREAD_STATE_RUNNING) {
+        ticketlock_release(lock);
+        threads_unlock(interrupts_were_enabled);
+        return -1;
+    }
+    thread_sched_priority_dequeue(t);
+    tickless_sleepers_remove(t);
+    // Keeps anyone from waking it, which would queue it again
+    t->tcb.state = THREAD_STATE_DEAD;
+    ticketlock_release(lock);
 
-    return NULL;
+    // These wake other threads, which takes run queue locks of it's own
+    ipc_thread_destroyed(t);
+    wait_queue_thread_destroyed(t);
+    // Unpublish the thread before it's memory goes away, the slot itself is only reused once that's done
+    const size_t slot = (size_t)(tid & THREAD_TID_IDX_MASK);
+    rcu_assign_pointer(THREADS[slot].thread, NULL);
+    threads_unlock(interrupts_were_enabled);
+
+    // Lookups without `THREADS_LOCK` may still be using the thread
+    rcu_synchronize();
+    stack_unmap(slot, t->stack_size);
+    slab_free(&THREADS_CACHE, t);
+    interrupts_were_enabled = threads_lock();
+    release_slot(slot);
+    threads_unlock(interrupts_were_enabled);
+    return 0;
 }
 
-int thread_lookup_idx_by_tid(thread_tid_t tid, size_t* idx) {
-    for (size_t i = 0; i < THREADS_NUM; i++) {
-        if (THREADS[i].tcb.tid == tid) {
-            *idx = i;
-            return 0;
-        }
+int thread_set_priority(thread_tid_t tid, thread_priority_t priority) {
+    // The idle priority is reserved, so the idle thread never competes with others
+    if (priority >= THREAD_PRIORITY_IDLE) {
+        return -1;
+    }
+    const bool interrupts_were_enabled = threads_lock();
+    struct thread_t* t = lookup_thread_by_tid(tid);
+    if (t == NULL || t->tcb.priority == THREAD_PRIORITY_IDLE) {
+        threads_unlock(interrupts_were_enabled);
+        return -1;
     }
 
-    return -1;
+    // Move the thread to the queue of it's new priority, if it's waiting in one
+    struct ticketlock_t* lock = run_queue_lock_of(t);
+    const bool queued = t->rq_queued;
+    thread_sched_priority_dequeue(t);
+    t->tcb.priority = priority;
+    if (queued) {
+        thread_sched_priority_enqueue(t);
+    }
+    ticketlock_release(lock);
+    threads_unlock(interrupts_were_enabled);
+    return 0;
 }
 
 void thread_start_idle(void) { kpanicf("%s: Not implemented", __func__); }
 
-void kprintf_cpu_state_t(const struct thread_cpu_state_t* const cpu_state) {
-    kprintf("==== CPU State ====\n");
-    kprintf("rip: %p\n", cpu_state->rip);
-    kprintf("rax: %p\n", cpu_state->rax);
-    kprintf("rbx: %p\n", cpu_state->rbx);
-    kprintf("rcx: %p\n", cpu_state->rcx);
-    kprintf("rdx: %p\n", cpu_state->rdx);
-    kprintf("rsi: %p\n", cpu_state->rsi);
-    kprintf("rdi: %p\n", cpu_state->rdi);
-    kprintf("rsp: %p\n", cpu_state->rsp);
-    kprintf("rbp: %p\n", cpu_state->rbp);
-    kprintf("r8:  %p\n", cpu_state->r8);
-    kprintf("r9:  %p\n", cpu_state->r9);
-    kprintf("r10: %p\n", cpu_state->r10);
-    kprintf("r11: %p\n", cpu_state->r11);
-    kprintf("r12: %p\n", cpu_state->r12);
-    kprintf("r13: %p\n", cpu_state->r13);
-    kprintf("r14: %p\n", cpu_state->r14);
-    kprintf("r15: %p\n", cpu_state->r15);
-    kprintf("===================\n");
-}
-
 void thread_dump_state(thread_tid_t tid) {
-    struct thread_tcb_t* t = thread_lookup_tcb_by_tid(tid);
-    if (t == NULL) {
-        kpanicf("tried to dump nonexistent thread with TID: %d\n", tid);
+    // Only reads, so it doesn't need to contend for `THREADS_LOCK`
+    const bool interrupts_were_enabled = rcu_read_lock();
+    const struct thread_t* thread = lookup_thread_by_tid(tid);
+    if (thread == NULL) {
+        kpanicf("tried to dump nonexistent thread with TID: %lu\n", tid);
     }
+    const struct thread_tcb_t* t = &thread->tcb;
     kprintf("==== Thread State ====\n");
     kprintf("tcb.stack_ptr: %p\n", t->stack_ptr);
     kprintf("tcb.state: ");
     kprintf_thread_state_t(t->state);
     kprintf("\n");
+    kprintf("tcb.priority: %u\n", t->priority);
     kprintf("===================\n");
-    const struct thread_cpu_state_t* const cpu_state = (struct thread_cpu_state_t*)t->stack_ptr;
-    kprintf_cpu_state_t(cpu_state);
-}
-
-static void load_cpu_state(const struct thread_cpu_state_t t_cpu, struct interrupt_isr_data_t* isr_data) {
-    isr_data->rax = t_cpu.rax;
-    isr_data->rbx = t_cpu.rbx;
-    isr_data->rcx = t_cpu.rcx;
-    isr_data->rdx = t_cpu.rdx;
-    isr_data->r8 = t_cpu.r8;
-    isr_data->r9 = t_cpu.r9;
-    isr_data->r10 = t_cpu.r10;
-    isr_data->r11 = t_cpu.r11;
-    isr_data->r12 = t_cpu.r12;
-    isr_data->r13 = t_cpu.r13;
-    isr_data->r14 = t_cpu.r14;
-    isr_data->r15 = t_cpu.r15;
-    isr_data->rdi = t_cpu.rdi;
-    isr_data->rsi = t_cpu.rsi;
-    isr_data->rbp = t_cpu.rbp;
-    isr_data->rip = t_cpu.rip;
-    isr_data->rsp = t_cpu.rsp;
-    // FIXME: Restore RFLAGS
-}
-
-void thread_switch_prepare(struct thread_cpu_state_t old_thread_cpu_state, thread_tid_t old_thread_tid,
-                           thread_tid_t new_thread_tid, struct interrupt_isr_data_t* isr_data) {
-    // Stack the old thread's registers
+    // The saved frame of the active thread is outdated, as it's registers live in the CPU
+    kprintf_interrupt_isr_data_t((const struct interrupt_isr_data_t*)t->stack_ptr);
+    rcu_read_unlock(interrupts_were_enabled);
+}
+
+/// Update the bookkeeping for a switch from `old_thread` to `new_thread`.
+///
+/// The caller is responsible for saving the old thread's frame and resuming the new one's.
+static void switch_bookkeeping(struct thread_t* old_thread, struct thread_t* new_thread) {
+    if (old_thread->tcb.state == THREAD_STATE_RUNNING) {
+        old_thread->tcb.state = THREAD_STATE_READY;
+    }
+    new_thread->tcb.state = THREAD_STATE_RUNNING;
+    new_thread->rq_cpu = smp_cpu()->id;
+    THREADS_ACTIVE_TID = new_thread->tcb.tid;
+    // Switching is only done outside of RCU read-side critical sections
+    rcu_quiescent();
+    // The old thread's caches are as warm as they get right when the new thread's slice begins
+    old_thread->rq_last_ran_ns = tickless_slice_begin();
+}
+
+void thread_switch_prepare(thread_tid_t old_thread_tid, thread_tid_t new_thread_tid,
+                           struct interrupt_isr_data_t* isr_data) {
     struct thread_t* old_thread = lookup_thread_by_tid(old_thread_tid);
     if (old_thread == NULL) {
-        kpanicf("%s: old_thread with TID %d does not exist", __func__, old_thread_tid);
+        kpanicf("%s: old_thread with TID %lu does not exist", __func__, old_thread_tid);
     }
-    // TODO: Change once user address space != kernel address space
-    struct thread_t* old_thread_stack_top = (struct thread_t*)old_thread_cpu_state.rsp;
-    save_cpu_state(old_thread_cpu_state, old_thread_stack_top);
-
     struct thread_t* new_thread = lookup_thread_by_tid(new_thread_tid);
     if (new_thread == NULL) {
-        kpanicf("%s: new_thread with TID %d does not exist", __func__, new_thread_tid);
+        kpanicf("%s: new_thread with TID %lu does not exist", __func__, new_thread_tid);
+    }
+    if (old_thread == new_thread) {
+        return;
+    }
+
+    // The frame pushed by the CPU and ASM stub on the old thread's stack already holds it's complete state,
+    // so remembering where it is suffices.
+    old_thread->tcb.stack_ptr = isr_data;
+    switch_bookkeeping(old_thread, new_thread);
+    // The ASM stub switches to the new thread's stack and restores everything, including RFLAGS, via iretq.
+    // Until it did, another CPU picking up the old thread would run on the stack this one is still using.
+    interrupt_resume_frame_set((struct interrupt_isr_data_t*)new_thread->tcb.stack_ptr);
+    interrupt_resume_unlock_set(thread_sched_priority_lock(smp_cpu()->id),
+                                (struct interrupt_isr_data_t*)new_thread->tcb.stack_ptr);
+}
+
+extern void thread_switch_cooperative_asm(void** old_thread_frame, void* new_thread_frame);
+
+void switch_cooperative(struct thread_t* new_thread) {
+    struct thread_t* old_thread = lookup_thread_by_tid(THREADS_ACTIVE_TID);
+    if (old_thread == NULL) {
+        kpanicf("%s: active thread with TID %lu does not exist", __func__, THREADS_ACTIVE_TID);
+    }
+    struct ticketlock_t* lock = thread_sched_priority_lock(smp_cpu()->id);
+    if (old_thread == new_thread) {
+        ticketlock_release(lock);
+        return;
     }
-    THREADS_ACTIVE_TID = new_thread_tid;
 
-    // TODO: Change once user address space != kernel address space
-    unsigned char* new_thread_stack_top = (unsigned char*)new_thread->tcb.stack_ptr;
-    struct thread_cpu_state_t* new_thread_cpu_state = (struct thread_cpu_state_t*)new_thread_stack_top;
-    // TODO: Is this the correct location on the stack?
-    // The part where we actually write to where the ISR loads them
-    load_cpu_state(*new_thread_cpu_state, isr_data);
+    switch_bookkeeping(old_thread, new_thread);
+    tickless_arm();
+    interrupt_resume_unlock_set(lock, (struct interrupt_isr_data_t*)new_thread->tcb.stack_ptr);
+    thread_switch_cooperative_asm(&old_thread->tcb.stack_ptr, new_thread->tcb.stack_ptr);
+    // Whoever switched back released their lock once they left this thread's stack, and interrupts are still disabled
 }
 
-extern void __attribute__((noreturn)) thread_switch_asm(unsigned char* thread_stack_top);
+struct thread_t* pick_next(void) {
+    struct thread_t* next = lookup_thread_by_tid(thread_sched_priority());
+    if (next == NULL) {
+        kpanicf("%s: Scheduler picked nonexistent thread", __func__);
+    }
+    return next;
+}
+
+void block(void) {
+    struct thread_t* active = lookup_thread_by_tid(THREADS_ACTIVE_TID);
+    if (active == NULL || THREADS_ACTIVE_TID == THREADS_IDLE_TID) {
+        kpanicf("%s: Only threads other than idle threads may block", __func__);
+    }
+    // Taken before the thread counts as blocked, so that wakers wait for the switch to complete
+    ticketlock_acquire(thread_sched_priority_lock(smp_cpu()->id));
+    active->tcb.state = THREAD_STATE_BLOCKED;
+    // Nothing the switch does needs it, and other CPUs may wake threads meanwhile
+    ticketlock_release(&THREADS_LOCK);
+    // Not being RUNNING anymore keeps the scheduler from queueing it
+    switch_cooperative(pick_next());
+    ticketlock_acquire(&THREADS_LOCK);
+}
+
+/// Check whether the CPU is running it's idle thread.
+static bool cpu_idle(size_t cpu) { return SMP_CPUS[cpu].thread_active_tid == SMP_CPUS[cpu].thread_idle_tid; }
+
+void wake(struct thread_t* t) {
+    if (t->tcb.state != THREAD_STATE_BLOCKED) {
+        return;
+    }
+    // The CPU the thread last ran on likely still has it's data cached, and an idle one picks it up soon.
+    // A busy CPU wouldn't notice the thread until it reschedules though, so then the waking CPU takes it instead,
+    // as it does when it's idle itself and can run the thread right away.
+    const size_t here = smp_cpu()->id;
+    size_t target = t->rq_cpu;
+    if (target != here && (!cpu_idle(target) || cpu_idle(here))) {
+        target = here;
+    }
+    // The CPU the thread blocked on may still be switching away from it, and holds it's lock until it's done
+    struct ticketlock_t* lock = run_queue_lock_of(t);
+    if (target != t->rq_cpu) {
+        ticketlock_release(lock);
+        lock = thread_sched_priority_lock(target);
+        ticketlock_acquire(lock);
+        t->rq_cpu = target;
+    }
+    t->tcb.state = THREAD_STATE_READY;
+    thread_sched_priority_enqueue(t);
+    if (target != here) {
+        ticketlock_release(lock);
+        // The idle CPU would otherwise only notice the thread once it looks for threads to steal
+        ipi_send(target, IPI_VECTOR_RESCHEDULE);
+        return;
+    }
+    // A more urgent thread takes over right away, rather than once the active thread's slice ends
+    const struct thread_t* active = lookup_thread_by_tid(THREADS_ACTIVE_TID);
+    if (active == NULL || THREADS_ACTIVE_TID == THREADS_IDLE_TID || t->tcb.priority < active->tcb.priority) {
+        tickless_preempt();
+    }
+    // The active thread may need a time slice deadline now that someone else is waiting
+    tickless_arm();
+    ticketlock_release(lock);
+}
+
+void thread_yield(void) {
+    const bool interrupts_were_enabled = run_queue_lock();
+    switch_cooperative(pick_next());
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
+
+extern void __attribute__((noreturn)) thread_switch_asm(struct interrupt_isr_data_t* frame);
 
 void __attribute__((noreturn)) thread_go(void) {
-    struct thread_t* idle = &THREADS[THREADS_IDLE_TID];
+    (void)run_queue_lock();
+    struct thread_t* idle = lookup_thread_by_tid(THREADS_IDLE_TID);
+    if (idle == NULL) {
+        kpanicf("%s: Idle thread does not exist, was threading initialized?", __func__);
+    }
     idle->tcb.state = THREAD_STATE_RUNNING;
+    idle->rq_cpu = smp_cpu()->id;
     THREADS_ACTIVE_TID = THREADS_IDLE_TID;
+    tickless_slice_begin();
+    tickless_arm();
+    // Released once the boot stack is left behind, like for any other switch
+    interrupt_resume_unlock_set(thread_sched_priority_lock(smp_cpu()->id), idle->tcb.stack_ptr);
     thread_switch_asm(idle->tcb.stack_ptr);
 }
 
-thread_tid_t thread_get_current_tid(void) { return THREADS_ACTIVE_TID; }
+thread_tid_t thread_get_current_tid(void) {
+    // Otherwise, the thread may be migrated between finding the CPU and reading from it
+    const bool interrupts_were_enabled = interrupt_enabled();
+    interrupt_disable();
+    const thread_tid_t tid = THREADS_ACTIVE_TID;
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+    return tid;
+}
@@ -0,0 +1,167 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common.h"
+#include "../include/thread.h"
+#include "hal/include/rcu.h"
+#include "hal/include/timer.h"
+#include "internal.h"
+#include "thread/sched/include/priority.h"
+#include "thread/sched/include/sched.h"
+
+/// Sleeping threads of each CPU, sorted by ascending wakeup deadline.
+///
+/// A thread sleeps on the CPU it ran on, whose timer wakes it. So every CPU only arms it's timer for the deadlines of
+/// it's own sleepers, rather than all of them taking the same interrupt for the earliest one.
+///
+/// Protected by the lock of the CPU's run queues, as are the CPU's sleepers' states.
+static struct thread_t *CPU_SLEEPERS[SMP_CPUS_MAX];
+
+/// Sleeping threads of the calling CPU.
+#define SLEEPERS (CPU_SLEEPERS[smp_cpu()->id])
+
+/// When the active thread's time slice started, on the calling CPU.
+#define SLICE_START_NS (smp_cpu()->tickless_slice_start_ns)
+
+/// Deadline the calling CPU's timer is currently armed for, or `0` if it has expired since.
+#define ARMED_DEADLINE_NS (smp_cpu()->tickless_armed_deadline_ns)
+
+/// Whether a more urgent thread became ready, which the calling CPU's active thread has to give way to right away.
+#define PREEMPT_PENDING (smp_cpu()->tickless_preempt_pending)
+
+/// Insert the thread into the sleepers of the CPU whose run queues it's in, keeping them sorted.
+static void sleepers_insert(struct thread_t *t) {
+    struct thread_t **link = &CPU_SLEEPERS[t->rq_cpu];
+    while (*link != NULL && (*link)->sleep_deadline_ns <= t->sleep_deadline_ns) {
+        link = &(*link)->sleep_next;
+    }
+    t->sleep_next = *link;
+    *link = t;
+}
+
+void tickless_sleepers_remove(struct thread_t *t) {
+    for (struct thread_t **link = &CPU_SLEEPERS[t->rq_cpu]; *link != NULL; link = &(*link)->sleep_next) {
+        if (*link == t) {
+            *link = t->sleep_next;
+            t->sleep_next = NULL;
+            return;
+        }
+    }
+}
+
+uint64_t tickless_slice_begin(void) {
+    SLICE_START_NS = timer_now_ns();
+    PREEMPT_PENDING = false;
+    return SLICE_START_NS;
+}
+
+void tickless_preempt(void) { PREEMPT_PENDING = true; }
+
+void tickless_arm(void) {
+    uint64_t deadline_ns = UINT64_MAX;
+    if (SLEEPERS != NULL) {
+        deadline_ns = SLEEPERS->sleep_deadline_ns;
+    }
+    // The slice only matters if someone else is waiting for the CPU.
+    // Otherwise, the active thread keeps running without being interrupted at all,
+    // unless other CPUs may wait for this one to pass through an RCU quiescent state.
+    if (THREADS_ACTIVE_TID != THREADS_IDLE_TID && (thread_sched_priority_pending() || smp_cpu_count() > 1)) {
+        const uint64_t slice_end_ns = SLICE_START_NS + THREAD_TIME_SLICE_NS;
+        if (slice_end_ns < deadline_ns) {
+            deadline_ns = slice_end_ns;
+        }
+    }
+    // Threads woken for an idle CPU come with a reschedule IPI. Threads left waiting on busy CPUs don't,
+    // so idle CPUs still check back for those every once in a while.
+    if (THREADS_ACTIVE_TID == THREADS_IDLE_TID && smp_cpu_count() > 1) {
+        const uint64_t balance_ns = SLICE_START_NS + THREAD_IDLE_BALANCE_NS;
+        if (balance_ns < deadline_ns) {
+            deadline_ns = balance_ns;
+        }
+    }
+    // Expire right away, the handler reschedules. The slice start stays the same until then, unlike the time now.
+    if (PREEMPT_PENDING && SLICE_START_NS < deadline_ns) {
+        deadline_ns = SLICE_START_NS;
+    }
+
+    // Already armed for this deadline, no need to touch the hardware
+    if (deadline_ns == ARMED_DEADLINE_NS) {
+        return;
+    }
+    ARMED_DEADLINE_NS = deadline_ns;
+
+    // Without any deadline, the timer is still armed for as long as it supports.
+    // This keeps timekeeping going on hardware which needs that.
+    const uint64_t now_ns = timer_now_ns();
+    timer_oneshot_arm(deadline_ns > now_ns ? deadline_ns - now_ns : 0);
+}
+
+/// Let the scheduler pick the thread to run next on the calling CPU, then arm the timer for the next deadline.
+///
+/// The lock of the calling CPU's run queues must be held.
+static void reschedule(struct interrupt_isr_data_t *isr_data) {
+    const thread_tid_t old_tid = THREADS_ACTIVE_TID;
+    thread_switch_prepare(old_tid, thread_sched_priority(), isr_data);
+    if (THREADS_ACTIVE_TID == old_tid) {
+        // Picked again, so the thread starts a new slice. When idle, the next look for threads to steal is
+        // one interval from now.
+        tickless_slice_begin();
+    }
+    tickless_arm();
+}
+
+void thread_timer_expired(struct interrupt_isr_data_t *isr_data) {
+    // Timer interrupts only arrive while interrupts are enabled, so the interrupted code wasn't an RCU reader.
+    // Neither does this handler hold on to anything it read before.
+    rcu_quiescent();
+    const bool interrupts_were_enabled = run_queue_lock();
+    ARMED_DEADLINE_NS = 0;
+    // Rescheduling below settles it, even if the active thread keeps running
+    PREEMPT_PENDING = false;
+
+    // Wake everyone whose deadline has passed. They slept on this CPU, so they go straight back to it's run queues.
+    const uint64_t now_ns = timer_now_ns();
+    while (SLEEPERS != NULL && SLEEPERS->sleep_deadline_ns <= now_ns) {
+        struct thread_t *t = SLEEPERS;
+        SLEEPERS = t->sleep_next;
+        t->sleep_next = NULL;
+        t->tcb.state = THREAD_STATE_READY;
+        thread_sched_priority_enqueue(t);
+    }
+
+    // Expiry means either the slice is used up or a sleeper woke up, both of which call for rescheduling
+    reschedule(isr_data);
+    run_queue_unlock(interrupts_were_enabled);
+}
+
+void thread_reschedule_requested(struct interrupt_isr_data_t *isr_data) {
+    // Like timer interrupts, IPIs only arrive while interrupts are enabled
+    rcu_quiescent();
+    const bool interrupts_were_enabled = run_queue_lock();
+    // Only idle CPUs are asked, which may have picked up a thread on their own in the meantime
+    if (THREADS_ACTIVE_TID == THREADS_IDLE_TID) {
+        reschedule(isr_data);
+    }
+    run_queue_unlock(interrupts_were_enabled);
+}
+
+void thread_sleep_ns(uint64_t duration_ns) {
+    const bool interrupts_were_enabled = run_queue_lock();
+
+    struct thread_t *t = lookup_thread_by_tid(THREADS_ACTIVE_TID);
+    if (t == NULL || THREADS_ACTIVE_TID == THREADS_IDLE_TID) {
+        kpanicf("%s: Only threads other than idle threads may sleep", __func__);
+    }
+    // Saturated, so that sleeping for very long doesn't wrap around to a deadline in the past
+    const uint64_t now_ns = timer_now_ns();
+    t->sleep_deadline_ns = duration_ns > UINT64_MAX - now_ns ? UINT64_MAX : now_ns + duration_ns;
+    sleepers_insert(t);
+    // Only this CPU's timer wakes it, so nothing but the run queue lock is needed to block
+    t->tcb.state = THREAD_STATE_BLOCKED;
+    switch_cooperative(pick_next());
+
+    if (interrupts_were_enabled) {
+        interrupt_enable();
+    }
+}
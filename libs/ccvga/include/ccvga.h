@@ -2,6 +2,12 @@
 
 #include <stdarg.h>
 
+/// Physical address of the VGA text buffer.
+#define VGA_TEXTBUF_PHYS 0x000B8000
+
+/// Access the text buffer at another address, for when it's no longer identity mapped.
+void vga_textbuf_set(volatile void* textbuf);
+
 /// Clears the VGA display and resets cursor position.
 void vga_clear(void);
 
@@ -12,10 +12,12 @@ static const size_t VGA_TEXTBUF_HEIGHT = 25;
 static size_t VGA_CURSOR_X = 0;
 static size_t VGA_CURSOR_Y = 0;
 // We assume a color output here, it's 2021 after all
-static volatile uint16_t* VGA_TEXTBUF = (volatile uint16_t*)0x000B8000;
+static volatile uint16_t* VGA_TEXTBUF = (volatile uint16_t*)VGA_TEXTBUF_PHYS;
 
 static const uint16_t VGA_WHITE_ON_BLACK_NOBLINK = 0x0F00;
 
+void vga_textbuf_set(volatile void* textbuf) { VGA_TEXTBUF = (volatile uint16_t*)textbuf; }
+
 void vga_clear(void) {
     VGA_CURSOR_X = 0;
     VGA_CURSOR_Y = 0;